@@ -12,21 +12,56 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
 #include "esp_mac.h"
 #include "esp_system.h"
+#include "config.h"
+#include "esp_crt_bundle.h"
 #include "mqtt_client.h"
-#include "nvs_flash.h"
+#include "perfmon.h"
 #include "sdkconfig.h"
 
 /* Private typedef -----------------------------------------------------------*/
 
+/**
+ * @brief A registered topic: the full topic string is materialized once
+ *        and every publish through the handle reuses it
+ */
+struct MQTT_Topic {
+   bool inUse;
+   char SubTopic[MAX_SUBTOPIC_LEN];
+   char FullTopic[MAX_TOPIC_LEN];
+   int QoS;       // Delivery QoS for publishes on this topic
+   bool Retain;   // Broker retains the last message
+};
+
+/**
+ * @brief A queued outbound message; the payload copy is owned by the
+ *        publisher task
+ */
+typedef struct {
+   const MQTT_Topic *Topic;
+   char *Payload;
+   int PayloadLength;
+} tx_msg_t;
+
 /* Private define ------------------------------------------------------------*/
 
-#define MAX_URLLEN    64           // Max length of broker URL
-#define NVS_NAMESPACE "SETTINGS"   // Namespace for the Settings
-#define MQTT_ID       "ESP32CAM"   // Start of the base ID
-#define MAX_RXMSG     10           // Number of received messages
+#define MQTT_ID         "ESP32CAM"   // Start of the base ID
+#define MAX_RXMSG       10           // Number of received messages
+#define KEEPALIVE_S     15           // [s] PINGREQ interval, dead link found in seconds
+#define RECONNECT_MS    2500         // [ms] Pause before a reconnect attempt
+#define NET_TIMEOUT_MS  5000         // [ms] Timeout for network operations
+#define MQTT_CHUNK_SIZE (16 * 1024)  // Chunk size for large transfers
+#define MAX_TXCONTROL   8            // Queued control messages
+#define MAX_TXBULK      2            // Queued bulk (image) transfers
+#define TX_TASK_STACK   4096         // Stack size of the publisher task
+#define TX_POLL_MS      20           // [ms] Publisher block on the control queue
+#define MAX_TOPICS      12           // Registered topic handles
+#define MAX_SUBS        8            // Tracked subscriptions
 
 /* Private macro -------------------------------------------------------------*/
 
@@ -38,11 +73,25 @@ static const char *TAG = "MQTT";
 static esp_mqtt_client_handle_t client = NULL;
 static bool isConnected = false;
 static char BaseTopic[MAX_BASE_LENGTH];
-static QueueHandle_t xRxQueue = NULL;
+static QueueHandle_t xRxQueue = NULL;     // Queue of MQTT_RXMessage pointers
+static QueueHandle_t xFreePool = NULL;    // Free message buffers
+static MQTT_RXMessage msgPool[MAX_RXMSG];
+static QueueHandle_t xTxControl = NULL;   // Small latency-sensitive messages
+static QueueHandle_t xTxBulk = NULL;      // Large chunked transfers
+static MQTT_Topic topics[MAX_TOPICS];
+static SemaphoreHandle_t xTopicLock = NULL;   // Guards the topic table
+static char subscriptions[MAX_SUBS][MAX_SUBTOPIC_LEN];   // Replayed on every (re)connect
 
 /* Private function prototypes -----------------------------------------------*/
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
+static void task_publisher(void *pvParameters);
+static esp_err_t publish_control(tx_msg_t *msg);
+static esp_err_t publish_bulk(tx_msg_t *msg);
+static esp_err_t tx_enqueue(QueueHandle_t queue, const MQTT_Topic *Topic, const char *Payload, int PayloadLength,
+                            uint32_t caps);
+static MQTT_Topic *topic_lookup(const char *SubTopic);
+static esp_err_t subscribe_send(const char *SubTopic);
 
 /* Private user code ---------------------------------------------------------*/
 
@@ -63,6 +112,12 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
    case MQTT_EVENT_CONNECTED:
       ESP_LOGD(TAG, "MQTT_EVENT_CONNECTED");
       isConnected = true;
+      // Replay subscriptions made before or between connections
+      for (int i = 0; i < MAX_SUBS; i++) {
+         if ('\0' != subscriptions[i][0]) {
+            subscribe_send(subscriptions[i]);
+         }
+      }
       break;
    case MQTT_EVENT_DISCONNECTED:
       isConnected = false;
@@ -80,33 +135,34 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
       ESP_LOGD(TAG, "MQTT_EVENT_PUBLISHED, msg_id=%d", event->msg_id);
       break;
    case MQTT_EVENT_DATA:
-      MQTT_RXMessage RxMsg;
-      char cBuffer[MAX_TOPIC_LEN];
+      MQTT_RXMessage *RxMsg = NULL;
 
       ESP_LOGD(TAG, "MQTT_EVENT_DATA");
 
-      // Queue full? Remove element
-      if (uxQueueSpacesAvailable(xRxQueue) == 0) {
-         ESP_LOGW(TAG, "RX queue full, removing element!");
-         xQueueReceive(xRxQueue, &RxMsg, 0);
-      }
-
       const size_t BaseTopic_len = strlen(BaseTopic);
 
       if ((BaseTopic_len > 0) && (BaseTopic_len < event->topic_len)) {
-         // Copy everything after basetopic/
-         memset(&cBuffer[0], 0x00, MAX_TOPIC_LEN);
-         memcpy(&cBuffer[0], event->topic + BaseTopic_len + 1, event->topic_len - BaseTopic_len - 1);
+         // Take a buffer from the pool; when it is exhausted, recycle the
+         // oldest undelivered message
+         if (pdTRUE != xQueueReceive(xFreePool, &RxMsg, 0)) {
+            ESP_LOGW(TAG, "RX queue full, removing element!");
+            if (pdTRUE != xQueueReceive(xRxQueue, &RxMsg, 0)) {
+               break;
+            }
+         }
 
-         // Copy into struct
-         memset(&RxMsg, 0x00, sizeof(RxMsg));
-         memcpy(&RxMsg.SubTopic[0], &cBuffer[0], MIN((MAX_TOPIC_LEN - MAX_BASE_LENGTH), strlen(cBuffer)));
-         memcpy(&RxMsg.Payload, event->data, MIN(event->data_len, (MAX_PAYLOAD)));
+         // Fill in place: everything after basetopic/ plus the payload
+         memset(RxMsg, 0x00, sizeof(*RxMsg));
+         memcpy(&RxMsg->SubTopic[0], event->topic + BaseTopic_len + 1,
+                MIN((size_t)(event->topic_len - BaseTopic_len - 1), sizeof(RxMsg->SubTopic) - 1));
+         RxMsg->PayloadLength = MIN(event->data_len, MAX_PAYLOAD - 1);
+         memcpy(&RxMsg->Payload[0], event->data, RxMsg->PayloadLength);
 
-         ESP_LOGD(TAG, "Enqueueing Rx message: Topic='%s' with %d bytes data", RxMsg.SubTopic, strlen(RxMsg.Payload));
+         ESP_LOGD(TAG, "Enqueueing Rx message: Topic='%s' with %d bytes data", RxMsg->SubTopic, RxMsg->PayloadLength);
 
-         if (!xQueueSend(xRxQueue, &RxMsg, 0)) {
+         if (pdTRUE != xQueueSend(xRxQueue, &RxMsg, 0)) {
             ESP_LOGW(TAG, "Failed to enqueue Rx message!");
+            xQueueSend(xFreePool, &RxMsg, 0);
          }
       } else {
          ESP_LOGE(TAG, "Cannot extract subtopic from '%.*s', BL=%d!", event->topic_len, event->topic, BaseTopic_len);
@@ -124,24 +180,177 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base, int32_
    }
 }   // mqtt_event_handler
 
+/**
+ * @brief Publish a control message synchronously and free its payload
+ */
+static esp_err_t publish_control(tx_msg_t *msg) {
+   esp_err_t res = ESP_OK;
+
+   // Topic string and delivery policy come precomputed from the handle
+   const int64_t pubStart = PERF_TimerStart();
+   int msg_id = esp_mqtt_client_publish(client, msg->Topic->FullTopic, msg->Payload, msg->PayloadLength,
+                                        msg->Topic->QoS, msg->Topic->Retain);
+   PERF_TimerStop(PERF_TIMER_MQTT_PUBLISH, pubStart);
+
+   if (0 > msg_id) {
+      ESP_LOGW(TAG, "Cannot transmit: Code %d", msg_id);
+      PERF_Add(PERF_CNT_MQTT_ERRORS, 1);
+      res = ESP_FAIL;
+   } else {
+      PERF_Add(PERF_CNT_MQTT_PUBLISHES, 1);
+   }
+
+   free(msg->Payload);
+   return res;
+}
+
+/**
+ * @brief Publish a bulk transfer in chunks, interleaving queued control
+ *        messages between chunks, and free its payload
+ */
+static esp_err_t publish_bulk(tx_msg_t *msg) {
+   char FullTopic[MAX_TOPIC_LEN];
+   char cMeta[64];
+   esp_err_t res = ESP_OK;
+
+   const int64_t pubStart = PERF_TimerStart();
+
+   // Publish chunk-sized slices so the outbox never has to copy the whole
+   // payload into internal heap at once
+   const int numChunks = (msg->PayloadLength + MQTT_CHUNK_SIZE - 1) / MQTT_CHUNK_SIZE;
+   for (int i = 0; (i < numChunks) && (ESP_OK == res); i++) {
+      // Control messages preempt the transfer between chunks
+      tx_msg_t ctrl;
+      while (pdTRUE == xQueueReceive(xTxControl, &ctrl, 0)) {
+         publish_control(&ctrl);
+      }
+
+      const int offset = i * MQTT_CHUNK_SIZE;
+      const int len = MIN(MQTT_CHUNK_SIZE, msg->PayloadLength - offset);
+
+      // Always QoS 0: chunks leave the outbox immediately instead of
+      // piling up in internal heap while awaiting PUBACKs
+      snprintf(&FullTopic[0], MAX_TOPIC_LEN, "%s/%d", msg->Topic->FullTopic, i);
+      int msg_id = esp_mqtt_client_publish(client, FullTopic, msg->Payload + offset, len, 0, 0);
+      if (0 > msg_id) {
+         ESP_LOGW(TAG, "Cannot transmit chunk %d/%d: Code %d", i + 1, numChunks, msg_id);
+         PERF_Add(PERF_CNT_MQTT_ERRORS, 1);
+         res = ESP_FAIL;
+      }
+   }
+
+   // Trailer so the consumer knows the transfer is complete
+   if (ESP_OK == res) {
+      snprintf(&cMeta[0], sizeof(cMeta), "{\"chunks\":%d,\"size\":%d}", numChunks, msg->PayloadLength);
+      snprintf(&FullTopic[0], MAX_TOPIC_LEN, "%s/end", msg->Topic->FullTopic);
+      int msg_id = esp_mqtt_client_publish(client, FullTopic, cMeta, strlen(cMeta), 0, 0);
+      PERF_TimerStop(PERF_TIMER_MQTT_PUBLISH, pubStart);
+      if (0 > msg_id) {
+         ESP_LOGW(TAG, "Cannot transmit trailer: Code %d", msg_id);
+         PERF_Add(PERF_CNT_MQTT_ERRORS, 1);
+         res = ESP_FAIL;
+      } else {
+         PERF_Add(PERF_CNT_MQTT_PUBLISHES, 1);
+      }
+   }
+
+   free(msg->Payload);
+   return res;
+}
+
+/**
+ * @brief Task: Drain the TX queues, control messages before bulk transfers
+ *
+ * No queue set: publish_bulk() drains xTxControl directly between chunks,
+ * which FreeRTOS forbids for queue-set members. The short block on the
+ * control queue doubles as the idle pacing.
+ */
+static void task_publisher(void *pvParameters) {
+   while (1) {
+      tx_msg_t msg;
+
+      if (pdTRUE == xQueueReceive(xTxControl, &msg, pdMS_TO_TICKS(TX_POLL_MS))) {
+         publish_control(&msg);
+         continue;
+      }
+      if (pdTRUE == xQueueReceive(xTxBulk, &msg, 0)) {
+         publish_bulk(&msg);
+      }
+   }
+}
+
+/**
+ * @brief Find a registered topic by its subtopic
+ *
+ * Called with xTopicLock held.
+ */
+static MQTT_Topic *topic_lookup(const char *SubTopic) {
+   for (int i = 0; i < MAX_TOPICS; i++) {
+      if (topics[i].inUse && (0 == strcmp(topics[i].SubTopic, SubTopic))) {
+         return &topics[i];
+      }
+   }
+   return NULL;
+}
+
+/**
+ * @brief Copy a payload and enqueue it for the publisher task
+ */
+static esp_err_t tx_enqueue(QueueHandle_t queue, const MQTT_Topic *Topic, const char *Payload, int PayloadLength,
+                            uint32_t caps) {
+   tx_msg_t msg;
+
+   if (!isConnected) {
+      ESP_LOGW(TAG, "Cannot transmit: Not connected");
+      return (ESP_FAIL);
+   }
+
+   if (0 == PayloadLength) {
+      PayloadLength = strlen(Payload);
+   }
+
+   memset(&msg, 0x00, sizeof(msg));
+   msg.Topic = Topic;
+   msg.Payload = heap_caps_malloc(PayloadLength, caps);
+   if (NULL == msg.Payload) {
+      ESP_LOGW(TAG, "Cannot transmit: No memory for %d bytes", PayloadLength);
+      return (ESP_ERR_NO_MEM);
+   }
+   memcpy(msg.Payload, Payload, PayloadLength);
+   msg.PayloadLength = PayloadLength;
+
+   if (pdTRUE != xQueueSend(queue, &msg, 0)) {
+      ESP_LOGW(TAG, "Cannot transmit: TX queue full");
+      free(msg.Payload);
+      return (ESP_FAIL);
+   }
+   return (ESP_OK);
+}
+
 /* Public user code ----------------------------------------------------------*/
 
 esp_err_t MQTT_Init(void) {
-   size_t url_length = MAX_URLLEN;
-   esp_err_t ret = ESP_OK;
-   nvs_handle_t handle;
-   char cBuffer[MAX_URLLEN];
    uint8_t Mac[6];
 
-   // Read in broker URL
-   ret = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle);
-   ESP_ERROR_CHECK(ret);
-   ret = nvs_get_str(handle, "MQTT_URL", &cBuffer[0], &url_length);
-   ESP_ERROR_CHECK(ret);
-   nvs_close(handle);
+   // Broker URL comes from the settings cache (one NVS read at boot)
+   if (0 == strlen(CFG_GetMqttUrl())) {
+      ESP_LOGE(TAG, "No broker URL configured!");
+      return (ESP_FAIL);
+   }
    esp_mqtt_client_config_t mqtt_cfg = {
-       .broker.address.uri = cBuffer,
+       .broker.address.uri = CFG_GetMqttUrl(),
+       // Tight keepalive/reconnect: together with the WiFi backoff the
+       // outage-to-publishing recovery stays in the single-digit seconds
+       .session.keepalive = KEEPALIVE_S,
+       .network.reconnect_timeout_ms = RECONNECT_MS,
+       .network.timeout_ms = NET_TIMEOUT_MS,
    };
+   if (0 == strncmp(mqtt_cfg.broker.address.uri, "mqtts://", 8)) {
+      // Verify against the built-in CA bundle, attached once at init. With
+      // CONFIG_ESP_TLS_CLIENT_SESSION_TICKETS the client resumes the TLS
+      // session on reconnect instead of paying a full handshake
+      mqtt_cfg.broker.verification.crt_bundle_attach = esp_crt_bundle_attach;
+   }
    ESP_LOGI(TAG, "Broker address is: %s", mqtt_cfg.broker.address.uri);
 
    // Setup MQTT client
@@ -155,37 +364,120 @@ esp_err_t MQTT_Init(void) {
             Mac[4], Mac[5]);
    ESP_LOGI(TAG, "Basetopic is '%s'", BaseTopic);
 
-   // Create queue for received data
-   xRxQueue = xQueueCreate(MAX_RXMSG, sizeof(MQTT_RXMessage));
-   if (NULL == xRxQueue) {
+   // Topic table: full topic strings are materialized at registration
+   memset(&topics[0], 0x00, sizeof(topics));
+   xTopicLock = xSemaphoreCreateMutex();
+   if (NULL == xTopicLock) {
+      ESP_LOGE(TAG, "Failed to create topic lock!");
+      return (ESP_FAIL);
+   }
+
+   // Create the RX queue and the buffer pool behind it; both only carry
+   // pointers into msgPool
+   xRxQueue = xQueueCreate(MAX_RXMSG, sizeof(MQTT_RXMessage *));
+   xFreePool = xQueueCreate(MAX_RXMSG, sizeof(MQTT_RXMessage *));
+   if ((NULL == xRxQueue) || (NULL == xFreePool)) {
       ESP_LOGE(TAG, "Failed to create RX queue!");
+   } else {
+      for (int i = 0; i < MAX_RXMSG; i++) {
+         MQTT_RXMessage *msg = &msgPool[i];
+         xQueueSend(xFreePool, &msg, 0);
+      }
+   }
+
+   // TX queues and the publisher task: control messages are drained before
+   // and between the chunks of bulk transfers
+   xTxControl = xQueueCreate(MAX_TXCONTROL, sizeof(tx_msg_t));
+   xTxBulk = xQueueCreate(MAX_TXBULK, sizeof(tx_msg_t));
+   if ((NULL == xTxControl) || (NULL == xTxBulk)) {
+      ESP_LOGE(TAG, "Failed to create TX queues!");
+      return (ESP_FAIL);
+   }
+
+   // Publishing runs on the comms core with WiFi/lwIP
+   if (pdPASS != xTaskCreatePinnedToCore(task_publisher, "MQTT TX", TX_TASK_STACK, NULL, tskIDLE_PRIORITY + 1, NULL,
+                                         0)) {
+      ESP_LOGE(TAG, "Failed to create publisher task!");
+      return (ESP_FAIL);
    }
 
    return (ESP_OK);
 }
 
-esp_err_t MQTT_Transmit(const char *SubTopic, const char *Payload, const int PayloadLength) {
-   char FullTopic[MAX_TOPIC_LEN];
+MQTT_Topic *MQTT_RegisterTopic(const char *SubTopic, const int QoS, const bool Retain) {
+   MQTT_Topic *topic = NULL;
 
-   if (!isConnected) {
-      ESP_LOGW(TAG, "Cannot transmit: Not connected");
-      return (ESP_FAIL);
+   if ((NULL == SubTopic) || (QoS < 0) || (QoS > 2)) {
+      return NULL;
    }
 
-   // generate full topic: Bae Topic / Subtopic(s)
-   snprintf(&FullTopic[0], MAX_TOPIC_LEN, "%s/%s", BaseTopic, SubTopic);
+   xSemaphoreTake(xTopicLock, portMAX_DELAY);
+   topic = topic_lookup(SubTopic);
+   if (NULL == topic) {
+      for (int i = 0; i < MAX_TOPICS; i++) {
+         if (!topics[i].inUse) {
+            topic = &topics[i];
+            snprintf(&topic->SubTopic[0], MAX_SUBTOPIC_LEN, "%s", SubTopic);
+            snprintf(&topic->FullTopic[0], MAX_TOPIC_LEN, "%s/%s", BaseTopic, SubTopic);
+            topic->inUse = true;
+            break;
+         }
+      }
+   }
+   if (NULL != topic) {
+      // Re-registering updates the delivery policy
+      topic->QoS = QoS;
+      topic->Retain = Retain;
+   } else {
+      ESP_LOGE(TAG, "No free topic slot for '%s'!", SubTopic);
+   }
+   xSemaphoreGive(xTopicLock);
 
-   // Transmit, QoS always 1 and no retaining
-   int msg_id = esp_mqtt_client_publish(client, FullTopic, Payload, PayloadLength, 1, 0);
+   return topic;
+}
 
-   if (0 > msg_id) {
-      ESP_LOGW(TAG, "Cannot transmit: Code %d", msg_id);
-      return (ESP_FAIL);
+esp_err_t MQTT_Publish(MQTT_Topic *Topic, const char *Payload, const int PayloadLength) {
+   if (NULL == Topic) {
+      return (ESP_ERR_INVALID_ARG);
    }
-   return (ESP_OK);
+   // Small messages go out with internal-RAM copies, ahead of any bulk transfer
+   return tx_enqueue(xTxControl, Topic, Payload, PayloadLength, MALLOC_CAP_DEFAULT);
 }
 
-esp_err_t MQTT_Subscribe(const char *SubTopic) {
+esp_err_t MQTT_PublishLarge(MQTT_Topic *Topic, const char *Payload, const int PayloadLength) {
+   if (NULL == Topic) {
+      return (ESP_ERR_INVALID_ARG);
+   }
+   // Bulk payloads are staged in PSRAM and chunked by the publisher task
+   return tx_enqueue(xTxBulk, Topic, Payload, PayloadLength, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+}
+
+esp_err_t MQTT_Transmit(const char *SubTopic, const char *Payload, const int PayloadLength) {
+   // Unregistered callers get the historic policy: QoS 1, no retain. An
+   // existing registration keeps its policy.
+   xSemaphoreTake(xTopicLock, portMAX_DELAY);
+   MQTT_Topic *topic = topic_lookup(SubTopic);
+   xSemaphoreGive(xTopicLock);
+   if (NULL == topic) {
+      topic = MQTT_RegisterTopic(SubTopic, 1, false);
+   }
+   return MQTT_Publish(topic, Payload, PayloadLength);
+}
+
+esp_err_t MQTT_TransmitLarge(const char *SubTopic, const char *Payload, const int PayloadLength) {
+   xSemaphoreTake(xTopicLock, portMAX_DELAY);
+   MQTT_Topic *topic = topic_lookup(SubTopic);
+   xSemaphoreGive(xTopicLock);
+   if (NULL == topic) {
+      topic = MQTT_RegisterTopic(SubTopic, 1, false);
+   }
+   return MQTT_PublishLarge(topic, Payload, PayloadLength);
+}
+
+/**
+ * @brief Issue the actual subscribe for a subtopic
+ */
+static esp_err_t subscribe_send(const char *SubTopic) {
    char FullTopic[MAX_TOPIC_LEN];
 
    snprintf(&FullTopic[0], MAX_TOPIC_LEN, "%s/%s", BaseTopic, SubTopic);
@@ -200,9 +492,41 @@ esp_err_t MQTT_Subscribe(const char *SubTopic) {
    return (ESP_OK);
 }
 
+esp_err_t MQTT_Subscribe(const char *SubTopic) {
+   // Track the subscription so it survives reconnects and subscribes made
+   // before the first connection
+   int slot = -1;
+   for (int i = 0; i < MAX_SUBS; i++) {
+      if (0 == strcmp(subscriptions[i], SubTopic)) {
+         slot = i;
+         break;
+      }
+      if ((slot < 0) && ('\0' == subscriptions[i][0])) {
+         slot = i;
+      }
+   }
+   if (slot < 0) {
+      ESP_LOGE(TAG, "No free subscription slot for '%s'!", SubTopic);
+      return (ESP_ERR_NO_MEM);
+   }
+   snprintf(&subscriptions[slot][0], MAX_SUBTOPIC_LEN, "%s", SubTopic);
+
+   if (!isConnected) {
+      // Subscribed once the connection comes up
+      return (ESP_OK);
+   }
+   return subscribe_send(SubTopic);
+}
+
 esp_err_t MQTT_Unsubscribe(const char *SubTopic) {
    char FullTopic[MAX_TOPIC_LEN];
 
+   for (int i = 0; i < MAX_SUBS; i++) {
+      if (0 == strcmp(subscriptions[i], SubTopic)) {
+         subscriptions[i][0] = '\0';
+      }
+   }
+
    snprintf(&FullTopic[0], MAX_TOPIC_LEN, "%s/%s", BaseTopic, SubTopic);
 
    int msg_id = esp_mqtt_client_unsubscribe(client, FullTopic);
@@ -217,4 +541,11 @@ esp_err_t MQTT_Unsubscribe(const char *SubTopic) {
 
 QueueHandle_t MQTT_GetRxQueue() { return (xRxQueue); }
 
+void MQTT_ReleaseRxMessage(MQTT_RXMessage *Msg) {
+   if ((NULL == Msg) || (NULL == xFreePool)) {
+      return;
+   }
+   xQueueSend(xFreePool, &Msg, 0);
+}
+
 bool MQTT_isConnected() { return isConnected; }
\ No newline at end of file
@@ -23,17 +23,26 @@ extern "C" {
 
 /* Exported constants --------------------------------------------------------*/
 
-#define MAX_TOPIC_LEN   250   // Max length of full topic
-#define MAX_BASE_LENGTH 128   // Max length base topic
-#define MAX_PAYLOAD     128   // Max size of payload
+#define MAX_TOPIC_LEN    250   // Max length of full topic
+#define MAX_BASE_LENGTH  128   // Max length base topic
+#define MAX_SUBTOPIC_LEN 64    // Max length of a subtopic
+#define MAX_PAYLOAD      512   // Max size of payload
 
 /* Exported types ------------------------------------------------------------*/
 
+/**
+ * @brief A received message. Buffers live in a fixed pool, the RX queue
+ *        carries pointers; return consumed messages with
+ *        MQTT_ReleaseRxMessage().
+ */
 typedef struct MQTT_RXMessage {
    char SubTopic[MAX_TOPIC_LEN - MAX_BASE_LENGTH];
    char Payload[MAX_PAYLOAD];
+   int PayloadLength;   // Payload bytes (payload is also NUL terminated)
 } MQTT_RXMessage;
 
+typedef struct MQTT_Topic MQTT_Topic;   // Opaque registered topic handle
+
 /* Exported macro ------------------------------------------------------------*/
 
 /* Exported functions prototypes ---------------------------------------------*/
@@ -45,19 +54,86 @@ typedef struct MQTT_RXMessage {
  */
 esp_err_t MQTT_Init(void);
 
+/**
+ * @brief Register a topic and its delivery policy
+ *
+ * The full topic string is built once; publishes through the handle skip
+ * the per-message topic assembly. Registering an existing subtopic again
+ * returns the same handle with the policy updated.
+ *
+ * @param SubTopic The subtopic below the base topic
+ * @param QoS Delivery QoS (0..2) for MQTT_Publish(); chunked transfers
+ *            always go out at QoS 0
+ * @param Retain Broker retains the last message
+ * @return Topic handle, or NULL if the table is full
+ */
+MQTT_Topic *MQTT_RegisterTopic(const char *SubTopic, const int QoS, const bool Retain);
+
+/**
+ * @brief Publish to a registered topic
+ *
+ * The payload is copied and handed to the publisher task, which sends
+ * control messages ahead of any running bulk transfer.
+ *
+ * @param Topic The registered topic handle
+ * @param Payload The payload to send
+ * @param PayloadLength Length of the payload or 0
+ * @return esp_err_t (of the enqueue, delivery is asynchronous)
+ */
+esp_err_t MQTT_Publish(MQTT_Topic *Topic, const char *Payload, const int PayloadLength);
+
+/**
+ * @brief Publish a large payload to a registered topic in chunks
+ *
+ * Chunked like MQTT_TransmitLarge(), with the chunk suffixes appended to
+ * the precomputed topic string. Chunks and trailer always go out at
+ * QoS 0 so they leave the outbox immediately; the topic's QoS only
+ * applies to MQTT_Publish().
+ *
+ * @param Topic The registered topic handle
+ * @param Payload The payload to send
+ * @param PayloadLength Length of the payload
+ * @return esp_err_t (of the enqueue, delivery is asynchronous)
+ */
+esp_err_t MQTT_PublishLarge(MQTT_Topic *Topic, const char *Payload, const int PayloadLength);
+
 /**
  * @brief Transmit Data to MQTT
  *
+ * Convenience wrapper around MQTT_Publish() that registers the subtopic
+ * on first use with QoS 1 and no retain.
+ *
  * @param SubTopic The subtopic to send to
  * @param Payload The payload to send
  * @param PayloadLength Length of the payload or 0
- * @return esp_err_t
+ * @return esp_err_t (of the enqueue, delivery is asynchronous)
  */
 esp_err_t MQTT_Transmit(const char *SubTopic, const char *Payload, const int PayloadLength);
 
+/**
+ * @brief Transmit a large payload in chunks
+ *
+ * The payload is staged in PSRAM and published by the publisher task as
+ * chunk-sized slices to SubTopic/<n> followed by a JSON trailer on
+ * SubTopic/end, so the MQTT outbox never holds a copy of the full
+ * payload in internal heap. Queued control messages interleave between
+ * chunks instead of waiting for the whole transfer. Registers the
+ * subtopic on first use with QoS 1 and no retain; the chunks themselves
+ * are always published at QoS 0.
+ *
+ * @param SubTopic The subtopic to send to
+ * @param Payload The payload to send
+ * @param PayloadLength Length of the payload
+ * @return esp_err_t (of the enqueue, delivery is asynchronous)
+ */
+esp_err_t MQTT_TransmitLarge(const char *SubTopic, const char *Payload, const int PayloadLength);
+
 /**
  * @brief Subscribe to a subtopic
  *
+ * Subscriptions are tracked and replayed on every (re)connect, so
+ * subscribing before the broker connection is up is fine.
+ *
  * @param SubTopic
  * @return esp_err_t
  */
@@ -74,10 +150,20 @@ esp_err_t MQTT_Unsubscribe(const char *SubTopic);
 /**
  * @brief Get the handle to the RX queue
  *
+ * The queue carries MQTT_RXMessage pointers; release each received
+ * message back to the pool after use.
+ *
  * @return QueueHandle_t
  */
 QueueHandle_t MQTT_GetRxQueue();
 
+/**
+ * @brief Return a received message buffer to the pool
+ *
+ * @param Msg The message taken from the RX queue
+ */
+void MQTT_ReleaseRxMessage(MQTT_RXMessage *Msg);
+
 /**
  * @brief Check if MQTT is connected
  *
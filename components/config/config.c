@@ -0,0 +1,193 @@
+/**
+ ******************************************************************************
+ *  file           : config.c
+ *  brief          : RAM-cached settings with runtime tunables
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "config.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs_flash.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+// The RAM copy of all settings
+typedef struct {
+   char wifiSSID[CFG_MAX_STRLEN];
+   char wifiPass[CFG_MAX_STRLEN];
+   char mqttUrl[CFG_MAX_STRLEN];
+   uint32_t statsInterval;   // [ms]
+   uint32_t imageInterval;   // [ms]
+} settings_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define NVS_NAMESPACE  "SETTINGS"   // Namespace for the Settings
+#define PERSIST_DELAY  1000         // [ms] Debounce before writing to NVS
+#define PERSIST_STACK  3072         // Stack size of the persist task
+
+#define DEFAULT_STATS_INTERVAL (30 * 1000)   // [ms]
+#define DEFAULT_IMAGE_INTERVAL (60 * 1000)   // [ms]
+#define MIN_INTERVAL           1000          // [ms] Sanity floor for cycle times
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "CONFIG";
+
+static settings_t settings;
+static SemaphoreHandle_t xDirty = NULL;   // Signals the persist task
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_persist(void *pvParameters);
+static void nvs_read_str(nvs_handle_t handle, const char *key, char *out, size_t outLen);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Read one string setting, leaving the default on a missing key
+ */
+static void nvs_read_str(nvs_handle_t handle, const char *key, char *out, size_t outLen) {
+   size_t len = outLen;
+   if (ESP_OK != nvs_get_str(handle, key, out, &len)) {
+      ESP_LOGW(TAG, "No value for '%s' in NVS", key);
+   }
+}
+
+/**
+ * @brief Task: Persist the RAM copy to NVS after changes
+ *
+ * Debounces bursts (a fleet-wide retained config message touches several
+ * keys at once) into a single NVS commit.
+ *
+ * @param pvParameters unused
+ */
+static void task_persist(void *pvParameters) {
+   nvs_handle_t handle;
+
+   while (1) {
+      xSemaphoreTake(xDirty, portMAX_DELAY);
+      vTaskDelay(pdMS_TO_TICKS(PERSIST_DELAY));
+      // Collapse further updates that arrived during the debounce
+      while (pdTRUE == xSemaphoreTake(xDirty, 0)) {
+      }
+
+      if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle)) {
+         ESP_LOGE(TAG, "Cannot open NVS for persisting!");
+         continue;
+      }
+      nvs_set_str(handle, "WIFI_SSID", settings.wifiSSID);
+      nvs_set_str(handle, "WIFI_PASS", settings.wifiPass);
+      nvs_set_str(handle, "MQTT_URL", settings.mqttUrl);
+      nvs_set_u32(handle, "STATS_IVAL", settings.statsInterval);
+      nvs_set_u32(handle, "IMAGE_IVAL", settings.imageInterval);
+      nvs_commit(handle);
+      nvs_close(handle);
+      ESP_LOGI(TAG, "Settings persisted");
+   }
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t CFG_Init(void) {
+   nvs_handle_t handle;
+
+   memset(&settings, 0x00, sizeof(settings));
+   settings.statsInterval = DEFAULT_STATS_INTERVAL;
+   settings.imageInterval = DEFAULT_IMAGE_INTERVAL;
+
+   // The single NVS read at boot, everything else hits the RAM copy
+   if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle)) {
+      ESP_LOGW(TAG, "No settings in NVS, using defaults");
+   } else {
+      nvs_read_str(handle, "WIFI_SSID", &settings.wifiSSID[0], sizeof(settings.wifiSSID));
+      nvs_read_str(handle, "WIFI_PASS", &settings.wifiPass[0], sizeof(settings.wifiPass));
+      nvs_read_str(handle, "MQTT_URL", &settings.mqttUrl[0], sizeof(settings.mqttUrl));
+      nvs_get_u32(handle, "STATS_IVAL", &settings.statsInterval);
+      nvs_get_u32(handle, "IMAGE_IVAL", &settings.imageInterval);
+      nvs_close(handle);
+   }
+
+   xDirty = xSemaphoreCreateBinary();
+   if (NULL == xDirty) {
+      ESP_LOGE(TAG, "Failed to create semaphore!");
+      return ESP_FAIL;
+   }
+   if (pdPASS != xTaskCreate(task_persist, "Cfg Persist", PERSIST_STACK, NULL, tskIDLE_PRIORITY + 1, NULL)) {
+      ESP_LOGE(TAG, "Failed to create persist task!");
+      return ESP_FAIL;
+   }
+
+   ESP_LOGI(TAG, "Settings loaded (stats %" PRIu32 " ms, image %" PRIu32 " ms)", settings.statsInterval,
+            settings.imageInterval);
+   return ESP_OK;
+}
+
+esp_err_t CFG_Set(const char *Key, const char *Value) {
+   bool secret = false;
+
+   if ((NULL == Key) || (NULL == Value)) {
+      return ESP_ERR_INVALID_ARG;
+   }
+
+   if (0 == strcmp(Key, "wifi_ssid")) {
+      snprintf(&settings.wifiSSID[0], sizeof(settings.wifiSSID), "%s", Value);
+   } else if (0 == strcmp(Key, "wifi_pass")) {
+      snprintf(&settings.wifiPass[0], sizeof(settings.wifiPass), "%s", Value);
+      secret = true;
+   } else if (0 == strcmp(Key, "mqtt_url")) {
+      // The URL may embed broker credentials
+      snprintf(&settings.mqttUrl[0], sizeof(settings.mqttUrl), "%s", Value);
+      secret = true;
+   } else if (0 == strcmp(Key, "stats_interval")) {
+      const long val = atol(Value);
+      if (val < MIN_INTERVAL) {
+         return ESP_ERR_INVALID_ARG;
+      }
+      settings.statsInterval = (uint32_t)val;
+   } else if (0 == strcmp(Key, "image_interval")) {
+      const long val = atol(Value);
+      if (val < MIN_INTERVAL) {
+         return ESP_ERR_INVALID_ARG;
+      }
+      settings.imageInterval = (uint32_t)val;
+   } else {
+      ESP_LOGW(TAG, "Unknown setting '%s'", Key);
+      return ESP_ERR_NOT_FOUND;
+   }
+
+   // Never echo secrets to the console
+   if (secret) {
+      ESP_LOGI(TAG, "Set '%s'", Key);
+   } else {
+      ESP_LOGI(TAG, "Set '%s' to '%s'", Key, Value);
+   }
+   xSemaphoreGive(xDirty);
+   return ESP_OK;
+}
+
+const char *CFG_GetWifiSSID(void) { return settings.wifiSSID; }
+
+const char *CFG_GetWifiPass(void) { return settings.wifiPass; }
+
+const char *CFG_GetMqttUrl(void) { return settings.mqttUrl; }
+
+uint32_t CFG_GetStatsInterval(void) { return settings.statsInterval; }
+
+uint32_t CFG_GetImageInterval(void) { return settings.imageInterval; }
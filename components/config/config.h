@@ -0,0 +1,75 @@
+/**
+ ******************************************************************************
+ *  file           : config.h
+ *  brief          : RAM-cached settings with runtime tunables
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef CONFIG_H_
+#define CONFIG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+#define CFG_MAX_STRLEN 64   // Max length of string settings (incl. NUL)
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Read all settings from NVS into RAM in one pass
+ *
+ * Call once at boot before WiFi/MQTT init; everything else reads from
+ * the RAM copy.
+ *
+ * @return esp_err_t
+ */
+esp_err_t CFG_Init(void);
+
+/**
+ * @brief Update a setting by name
+ *
+ * Known keys: wifi_ssid, wifi_pass, mqtt_url, stats_interval,
+ * image_interval (intervals in ms). The RAM copy changes immediately -
+ * tasks reading the accessors pick it up on their next cycle - and the
+ * value is persisted to NVS asynchronously.
+ *
+ * @param Key The setting name
+ * @param Value The new value as string
+ * @return esp_err_t, ESP_ERR_NOT_FOUND for an unknown key
+ */
+esp_err_t CFG_Set(const char *Key, const char *Value);
+
+/** @brief WiFi SSID (applied at the next WiFi init) */
+const char *CFG_GetWifiSSID(void);
+
+/** @brief WiFi password (applied at the next WiFi init) */
+const char *CFG_GetWifiPass(void);
+
+/** @brief MQTT broker URL (applied at the next MQTT init) */
+const char *CFG_GetMqttUrl(void);
+
+/** @brief Cycle time of the MQTT stats message [ms] */
+uint32_t CFG_GetStatsInterval(void);
+
+/** @brief Cycle time of the MQTT heartbeat image [ms] */
+uint32_t CFG_GetImageInterval(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CONFIG_H_
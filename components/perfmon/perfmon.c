@@ -0,0 +1,146 @@
+/**
+ ******************************************************************************
+ *  file           : perfmon.c
+ *  brief          : Lightweight performance counters for the hot paths
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "perfmon.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   uint32_t count;    // Number of samples
+   uint32_t sum_us;   // Accumulated duration
+   uint32_t min_us;   // Shortest sample
+   uint32_t max_us;   // Longest sample
+} timer_stats_t;
+
+/* Private define ------------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+// Counters and timers are updated from tasks on both cores and the
+// updates are read-modify-writes, so a shared spinlock makes them
+// atomic. Each critical section is a handful of instructions, the hot
+// paths stay cheap
+static portMUX_TYPE perfLock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t counters[PERF_CNT_MAX];
+static timer_stats_t timers[PERF_TIMER_MAX];
+
+static const char *counterNames[PERF_CNT_MAX] = {
+    [PERF_CNT_FRAMES_CAPTURED] = "frames_captured",
+    [PERF_CNT_FRAMES_DROPPED] = "frames_dropped",
+    [PERF_CNT_STREAM_FRAMES] = "stream_frames",
+    [PERF_CNT_STREAM_BYTES] = "stream_bytes",
+    [PERF_CNT_SNAPSHOTS] = "snapshots",
+    [PERF_CNT_SNAPSHOT_CACHE_HITS] = "snapshot_cache_hits",
+    [PERF_CNT_MQTT_PUBLISHES] = "mqtt_publishes",
+    [PERF_CNT_MQTT_ERRORS] = "mqtt_errors",
+    [PERF_CNT_CONV_POOL_MISSES] = "conv_pool_misses",
+    [PERF_CNT_CONV_BUFFERS_HW] = "conv_buffers_highwater",
+};
+
+static const char *timerNames[PERF_TIMER_MAX] = {
+    [PERF_TIMER_CAPTURE] = "capture_us",
+    [PERF_TIMER_STREAM_SEND] = "stream_send_us",
+    [PERF_TIMER_SNAPSHOT] = "snapshot_us",
+    [PERF_TIMER_MQTT_PUBLISH] = "mqtt_publish_us",
+};
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private user code ---------------------------------------------------------*/
+
+/* Public user code ----------------------------------------------------------*/
+
+void PERF_Add(PERF_Counter Counter, uint32_t Value) {
+   if (Counter < PERF_CNT_MAX) {
+      portENTER_CRITICAL(&perfLock);
+      counters[Counter] += Value;
+      portEXIT_CRITICAL(&perfLock);
+   }
+}
+
+void PERF_Max(PERF_Counter Counter, uint32_t Value) {
+   if (Counter < PERF_CNT_MAX) {
+      portENTER_CRITICAL(&perfLock);
+      if (Value > counters[Counter]) {
+         counters[Counter] = Value;
+      }
+      portEXIT_CRITICAL(&perfLock);
+   }
+}
+
+int64_t PERF_TimerStart(void) { return esp_timer_get_time(); }
+
+void PERF_TimerStop(PERF_Timer Timer, int64_t Start) {
+   if (Timer >= PERF_TIMER_MAX) {
+      return;
+   }
+
+   const uint32_t us = (uint32_t)(esp_timer_get_time() - Start);
+   timer_stats_t *t = &timers[Timer];
+
+   portENTER_CRITICAL(&perfLock);
+   if ((0 == t->count) || (us < t->min_us)) {
+      t->min_us = us;
+   }
+   if (us > t->max_us) {
+      t->max_us = us;
+   }
+   t->sum_us += us;
+   t->count++;
+   portEXIT_CRITICAL(&perfLock);
+}
+
+size_t PERF_Export(char *Buf, size_t BufLen) {
+   uint32_t countersCopy[PERF_CNT_MAX];
+   timer_stats_t timersCopy[PERF_TIMER_MAX];
+   size_t used = 0;
+
+   // Snapshot under the lock, format outside it
+   portENTER_CRITICAL(&perfLock);
+   memcpy(&countersCopy[0], &counters[0], sizeof(countersCopy));
+   memcpy(&timersCopy[0], &timers[0], sizeof(timersCopy));
+   portEXIT_CRITICAL(&perfLock);
+
+   for (int i = 0; i < PERF_CNT_MAX; i++) {
+      int len = snprintf(Buf + used, BufLen - used, "# TYPE esp32cam_%s counter\nesp32cam_%s %" PRIu32 "\n",
+                         counterNames[i], counterNames[i], countersCopy[i]);
+      if ((len < 0) || ((size_t)len >= (BufLen - used))) {
+         return 0;
+      }
+      used += len;
+   }
+
+   for (int i = 0; i < PERF_TIMER_MAX; i++) {
+      const timer_stats_t t = timersCopy[i];
+      int len = snprintf(Buf + used, BufLen - used,
+                         "# TYPE esp32cam_%s summary\n"
+                         "esp32cam_%s_count %" PRIu32 "\n"
+                         "esp32cam_%s_sum %" PRIu32 "\n"
+                         "esp32cam_%s_min %" PRIu32 "\n"
+                         "esp32cam_%s_max %" PRIu32 "\n",
+                         timerNames[i], timerNames[i], t.count, timerNames[i], t.sum_us, timerNames[i], t.min_us,
+                         timerNames[i], t.max_us);
+      if ((len < 0) || ((size_t)len >= (BufLen - used))) {
+         return 0;
+      }
+      used += len;
+   }
+
+   return used;
+}
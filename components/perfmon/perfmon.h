@@ -0,0 +1,104 @@
+/**
+ ******************************************************************************
+ *  file           : perfmon.h
+ *  brief          : Lightweight performance counters for the hot paths
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef PERFMON_H_
+#define PERFMON_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/**
+ * @brief Event counters. Updates are single 32-bit writes, cheap enough
+ *        to stay enabled in production.
+ */
+typedef enum {
+   PERF_CNT_FRAMES_CAPTURED = 0,   // Frames grabbed by the capture task
+   PERF_CNT_FRAMES_DROPPED,        // Frames dropped (no slot / stale)
+   PERF_CNT_STREAM_FRAMES,         // Frames sent to stream clients
+   PERF_CNT_STREAM_BYTES,          // Bytes sent to stream clients
+   PERF_CNT_SNAPSHOTS,             // /snapshot responses served
+   PERF_CNT_SNAPSHOT_CACHE_HITS,   // /snapshot served from cache (incl. 304)
+   PERF_CNT_MQTT_PUBLISHES,        // Successful MQTT publishes
+   PERF_CNT_MQTT_ERRORS,           // Failed MQTT publishes
+   PERF_CNT_CONV_POOL_MISSES,      // Conversion buffer requests the pool could not serve
+   PERF_CNT_CONV_BUFFERS_HW,       // High-water mark of conversion buffers in use
+   PERF_CNT_MAX
+} PERF_Counter;
+
+/**
+ * @brief Duration statistics (count/sum/min/max in microseconds)
+ */
+typedef enum {
+   PERF_TIMER_CAPTURE = 0,    // esp_camera_fb_get duration
+   PERF_TIMER_STREAM_SEND,    // Per-frame stream send duration
+   PERF_TIMER_SNAPSHOT,       // /snapshot handler duration
+   PERF_TIMER_MQTT_PUBLISH,   // MQTT publish duration
+   PERF_TIMER_MAX
+} PERF_Timer;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Add to a counter
+ *
+ * @param Counter The counter
+ * @param Value Amount to add
+ */
+void PERF_Add(PERF_Counter Counter, uint32_t Value);
+
+/**
+ * @brief Raise a counter to a value if it is higher (high-water marks)
+ *
+ * @param Counter The counter
+ * @param Value Candidate value
+ */
+void PERF_Max(PERF_Counter Counter, uint32_t Value);
+
+/**
+ * @brief Start a duration measurement
+ *
+ * @return Opaque start marker for PERF_TimerStop
+ */
+int64_t PERF_TimerStart(void);
+
+/**
+ * @brief Finish a duration measurement and record it
+ *
+ * @param Timer The timer to record into
+ * @param Start The marker from PERF_TimerStart
+ */
+void PERF_TimerStop(PERF_Timer Timer, int64_t Start);
+
+/**
+ * @brief Export all counters in Prometheus text format
+ *
+ * @param Buf Output buffer
+ * @param BufLen Size of the buffer
+ * @return Number of bytes written (0 if the buffer is too small)
+ */
+size_t PERF_Export(char *Buf, size_t BufLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // PERFMON_H_
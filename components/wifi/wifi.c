@@ -7,13 +7,16 @@
 
 /* Includes ------------------------------------------------------------------*/
 
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 
 /* Private includes ----------------------------------------------------------*/
 
+#include "config.h"
 #include "esp_log.h"
 #include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/event_groups.h"
@@ -24,12 +27,11 @@
 
 /* Private define ------------------------------------------------------------*/
 
-#define WIFI_CONNECTED_BIT BIT0         // Event: Connected
-#define WIFI_FAIL_BIT      BIT1         // Event: Fail
-#define WIFI_MAXIMUM_RETRY 10           // Max number of retries
-#define MAX_SSIDLEN        128          // Max length of the SSID String
-#define MAX_PASSLEN        128          // Max length of the Password String
-#define NVS_NAMESPACE      "SETTINGS"   // Namespace for the Settings
+#define WIFI_CONNECTED_BIT  BIT0          // Event: Connected
+#define NVS_NAMESPACE       "SETTINGS"    // Namespace for the AP cache
+#define RECONNECT_MIN_MS    1000          // Initial reconnect backoff
+#define RECONNECT_MAX_MS    60000         // Backoff ceiling
+#define CACHE_DROP_RETRIES  3             // Failed fast-connects before a full scan
 
 /* Private macro -------------------------------------------------------------*/
 
@@ -40,31 +42,111 @@ static EventGroupHandle_t s_wifi_event_group;   // FreeRTOS event group to signa
 static int s_retry_num = 0;                     // Reconnect counter
 static esp_netif_t *wifi_NetIf;                 // The network interface
 static bool isConnected = false;                // Current connection state
+static esp_timer_handle_t reconnectTimer;       // One-shot backoff timer
+static uint32_t backoffMs = RECONNECT_MIN_MS;   // Current backoff
+static bool usingCachedAp = false;              // Fast-connect via stored BSSID/channel
 
 /* Private function prototypes -----------------------------------------------*/
 
 static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data);
+static void reconnect_cb(void *arg);
+static void cache_load(wifi_config_t *wifi_config);
+static void cache_store(void);
+static void cache_drop(void);
 
 /* Private user code ---------------------------------------------------------*/
 
+/**
+ * @brief Load the last BSSID and channel so association skips the
+ *        all-channel scan
+ */
+static void cache_load(wifi_config_t *wifi_config) {
+   nvs_handle_t handle;
+   size_t len = sizeof(wifi_config->sta.bssid);
+   uint8_t channel = 0;
+
+   if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle)) {
+      return;
+   }
+   if ((ESP_OK == nvs_get_blob(handle, "WIFI_BSSID", &wifi_config->sta.bssid[0], &len)) &&
+       (ESP_OK == nvs_get_u8(handle, "WIFI_CHAN", &channel))) {
+      wifi_config->sta.bssid_set = true;
+      wifi_config->sta.channel = channel;
+      usingCachedAp = true;
+      ESP_LOGI(TAG, "Fast connect on channel %d", channel);
+   }
+   nvs_close(handle);
+}
+
+/**
+ * @brief Persist the BSSID and channel of the AP we just connected to
+ */
+static void cache_store(void) {
+   wifi_ap_record_t ap;
+   nvs_handle_t handle;
+
+   if (ESP_OK != esp_wifi_sta_get_ap_info(&ap)) {
+      return;
+   }
+   if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle)) {
+      return;
+   }
+   nvs_set_blob(handle, "WIFI_BSSID", &ap.bssid[0], sizeof(ap.bssid));
+   nvs_set_u8(handle, "WIFI_CHAN", ap.primary);
+   nvs_commit(handle);
+   nvs_close(handle);
+}
+
+/**
+ * @brief Forget the cached AP and go back to a full scan
+ */
+static void cache_drop(void) {
+   wifi_config_t wifi_config;
+
+   if (!usingCachedAp) {
+      return;
+   }
+   if (ESP_OK == esp_wifi_get_config(ESP_IF_WIFI_STA, &wifi_config)) {
+      wifi_config.sta.bssid_set = false;
+      wifi_config.sta.channel = 0;
+      esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config);
+   }
+   usingCachedAp = false;
+   ESP_LOGW(TAG, "Dropping cached AP, scanning all channels");
+}
+
+/**
+ * @brief Timer callback: retry the connection
+ */
+static void reconnect_cb(void *arg) { esp_wifi_connect(); }
+
 static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data) {
    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
       esp_wifi_connect();
       isConnected = false;
    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-      if (s_retry_num < WIFI_MAXIMUM_RETRY) {
-         esp_wifi_connect();
-         s_retry_num++;
-         ESP_LOGI(TAG, "retry to connect to the AP");
-      } else {
-         xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-      }
-      ESP_LOGI(TAG, "connect to the AP fail");
       isConnected = false;
+      xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+      s_retry_num++;
+
+      // A relocated AP will never answer a fast connect, fall back to scanning
+      if (s_retry_num >= CACHE_DROP_RETRIES) {
+         cache_drop();
+      }
+
+      // Retry with exponential backoff, forever
+      ESP_LOGI(TAG, "Disconnected, retry %d in %" PRIu32 " ms", s_retry_num, backoffMs);
+      esp_timer_start_once(reconnectTimer, (uint64_t)backoffMs * 1000);
+      backoffMs *= 2;
+      if (backoffMs > RECONNECT_MAX_MS) {
+         backoffMs = RECONNECT_MAX_MS;
+      }
    } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
       ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
       ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
       s_retry_num = 0;
+      backoffMs = RECONNECT_MIN_MS;
+      cache_store();
       xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
       isConnected = true;
    }
@@ -73,10 +155,6 @@ static void event_handler(void *arg, esp_event_base_t event_base, int32_t event_
 /* Public user code ----------------------------------------------------------*/
 
 esp_err_t WiFi_Init(void) {
-   size_t ssid_length = MAX_SSIDLEN;
-   size_t password_length = MAX_PASSLEN;
-   nvs_handle_t handle;
-
    wifi_config_t wifi_config = {
        .sta =
            {
@@ -87,28 +165,25 @@ esp_err_t WiFi_Init(void) {
            },
    };
 
-   // Read in settings from NVS
-   if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle)) {
-      ESP_LOGE(TAG, "FAILED to open nvs");
-      return ESP_FAIL;
-   }
-
-   if (ESP_OK != nvs_get_str(handle, "WIFI_SSID", (char *)&wifi_config.sta.ssid[0], &ssid_length)) {
-      ESP_LOGE(TAG, "FAILED to read SSID from nvs");
-      nvs_close(handle);
+   // Credentials come from the settings cache (one NVS read at boot)
+   if (0 == strlen(CFG_GetWifiSSID())) {
+      ESP_LOGE(TAG, "No SSID configured");
       return ESP_FAIL;
    }
+   strlcpy((char *)&wifi_config.sta.ssid[0], CFG_GetWifiSSID(), sizeof(wifi_config.sta.ssid));
+   strlcpy((char *)&wifi_config.sta.password[0], CFG_GetWifiPass(), sizeof(wifi_config.sta.password));
 
-   if (ESP_OK != nvs_get_str(handle, "WIFI_PASS", (char *)&wifi_config.sta.password[0], &password_length)) {
-      ESP_LOGE(TAG, "FAILED to read pass from nvs");
-      nvs_close(handle);
-      return ESP_FAIL;
-   }
-
-   nvs_close(handle);
+   // Fast connect: reuse BSSID and channel from the last association
+   cache_load(&wifi_config);
 
    s_wifi_event_group = xEventGroupCreate();
 
+   const esp_timer_create_args_t timer_args = {
+       .callback = reconnect_cb,
+       .name = "wifi_reconnect",
+   };
+   ESP_ERROR_CHECK(esp_timer_create(&timer_args, &reconnectTimer));
+
    ESP_ERROR_CHECK(esp_netif_init());
 
    ESP_ERROR_CHECK(esp_event_loop_create_default());
@@ -117,45 +192,24 @@ esp_err_t WiFi_Init(void) {
    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-   esp_event_handler_instance_t instance_any_id;
-   esp_event_handler_instance_t instance_got_ip;
-   ESP_ERROR_CHECK(
-       esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, &instance_any_id));
-   ESP_ERROR_CHECK(
-       esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, &instance_got_ip));
+   // Handlers stay registered for the lifetime of the firmware so a router
+   // reboot months after boot still reconnects
+   ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &event_handler, NULL, NULL));
+   ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, IP_EVENT_STA_GOT_IP, &event_handler, NULL, NULL));
 
    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
    ESP_ERROR_CHECK(esp_wifi_set_config(ESP_IF_WIFI_STA, &wifi_config));
    ESP_ERROR_CHECK(esp_wifi_start());
-   ESP_LOGI(TAG, "Init finished");
-
-   /* Waiting until either the connection is established (WIFI_CONNECTED_BIT)
-      or connection failed for the maximum number of re-tries (WIFI_FAIL_BIT).
-      The bits are set by event_handler() (see above) */
-   EventBits_t bits =
-       xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
-
-   /* xEventGroupWaitBits() returns the bits before the call returned, hence we can test which event actually happened.
-    */
-   if (bits & WIFI_CONNECTED_BIT) {
-      ESP_LOGI(TAG, "Connected to AP, SSID: %s", wifi_config.sta.ssid);
-      isConnected = true;
-   } else if (bits & WIFI_FAIL_BIT) {
-      ESP_LOGI(TAG, "Failed to connect to SSID: %s", wifi_config.sta.ssid);
-      isConnected = false;
-   } else {
-      ESP_LOGE(TAG, "UNEXPECTED EVENT");
-      isConnected = false;
-   }
-
-   /* The event will not be processed after unregister */
-   ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-   ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
-   vEventGroupDelete(s_wifi_event_group);
+   ESP_LOGI(TAG, "Init finished, connecting to '%s' in background", wifi_config.sta.ssid);
 
    return (ESP_OK);
 }   // wifi_init
 
+esp_err_t WiFi_WaitConnected(TickType_t xTicksToWait) {
+   EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group, WIFI_CONNECTED_BIT, pdFALSE, pdFALSE, xTicksToWait);
+   return (bits & WIFI_CONNECTED_BIT) ? ESP_OK : ESP_ERR_TIMEOUT;
+}
+
 esp_netif_t *WiFi_GetNetIf() { return (wifi_NetIf); }
 
-bool WiFi_isConnected() { return (isConnected); }
\ No newline at end of file
+bool WiFi_isConnected() { return (isConnected); }
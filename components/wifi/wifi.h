@@ -9,6 +9,7 @@
 #define _WIFI_H_
 
 #include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -29,10 +30,23 @@ extern "C" {
 /**
  * @brief Init WiFi in station mode
  *
+ * Returns as soon as the connection attempt is started; association and
+ * lifetime reconnection (exponential backoff, cached BSSID/channel for
+ * fast connect) run in the background. Use WiFi_WaitConnected() to wait
+ * for the first connection.
+ *
  * @return esp_err_t
  */
 esp_err_t WiFi_Init(void);
 
+/**
+ * @brief Wait until WiFi is connected and has an IP
+ *
+ * @param xTicksToWait Max time to wait
+ * @return ESP_OK when connected, ESP_ERR_TIMEOUT otherwise
+ */
+esp_err_t WiFi_WaitConnected(TickType_t xTicksToWait);
+
 /**
  * @brief Get the network interface
  *
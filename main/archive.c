@@ -0,0 +1,206 @@
+/**
+ ******************************************************************************
+ *  file           : archive.c
+ *  brief          : Circular frame archive in PSRAM for pre-roll retrieval
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "archive.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+#include "broadcast.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "taskcfg.h"
+
+#ifdef CONFIG_ARCHIVE_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   size_t offset;       // Start of the JPEG in the ring
+   size_t len;          // JPEG length
+   int64_t timestamp;   // Capture time [us since boot]
+} record_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define ARCHIVE_MAX_RECORDS 64     // Max frames tracked in the index
+#define ARCHIVE_TASK_STACK  4096   // Stack size of the recorder task
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "ARCHIVE";
+
+static uint8_t *ring = NULL;   // Frame data ring in PSRAM
+static size_t ringSize = 0;
+static size_t head = 0;   // Next write offset
+
+static record_t records[ARCHIVE_MAX_RECORDS];   // Index, oldest first
+static uint16_t recFirst = 0;
+static uint16_t recCount = 0;
+
+static SemaphoreHandle_t xLock = NULL;
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_archive(void *pvParameters);
+static void archive_append(const uint8_t *buf, size_t len, int64_t timestamp);
+static void evict_oldest(void);
+static bool record_overlaps(const record_t *rec, size_t start, size_t end);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Drop the oldest record from the index
+ */
+static void evict_oldest(void) {
+   if (recCount > 0) {
+      recFirst = (recFirst + 1) % ARCHIVE_MAX_RECORDS;
+      recCount--;
+   }
+}
+
+/**
+ * @brief Check whether a record touches the byte range [start, end)
+ */
+static bool record_overlaps(const record_t *rec, size_t start, size_t end) {
+   return (rec->offset < end) && ((rec->offset + rec->len) > start);
+}
+
+/**
+ * @brief Append a JPEG to the ring, evicting the oldest frames as needed
+ */
+static void archive_append(const uint8_t *buf, size_t len, int64_t timestamp) {
+   if (len > ringSize) {
+      ESP_LOGW(TAG, "Frame of %u bytes exceeds ring size, dropped", len);
+      return;
+   }
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+
+   // Records never wrap: when the tail is too short, continue at offset 0
+   if ((head + len) > ringSize) {
+      head = 0;
+   }
+
+   // Make room: evict every record the new frame would overwrite
+   while (recCount > 0) {
+      if (ARCHIVE_MAX_RECORDS == recCount) {
+         evict_oldest();
+         continue;
+      }
+      const record_t *oldest = &records[recFirst];
+      if (record_overlaps(oldest, head, head + len)) {
+         evict_oldest();
+         continue;
+      }
+      break;
+   }
+
+   memcpy(ring + head, buf, len);
+   records[(recFirst + recCount) % ARCHIVE_MAX_RECORDS] =
+       (record_t){.offset = head, .len = len, .timestamp = timestamp};
+   recCount++;
+   head += len;
+
+   xSemaphoreGive(xLock);
+}
+
+/**
+ * @brief Task: Archive frames from the broadcaster at the configured rate
+ */
+static void task_archive(void *pvParameters) {
+   BC_Client *client = BC_Register(CONFIG_ARCHIVE_INTERVAL);
+   if (NULL == client) {
+      ESP_LOGE(TAG, "Failed to register with broadcaster!");
+      vTaskDelete(NULL);
+      return;
+   }
+
+   int64_t lastAppend = 0;
+
+   while (1) {
+      BC_Frame *frame = BC_WaitFrame(client, pdMS_TO_TICKS(1000));
+      if (NULL == frame) {
+         continue;
+      }
+
+      const int64_t now = esp_timer_get_time();
+      if ((now - lastAppend) >= ((int64_t)CONFIG_ARCHIVE_INTERVAL * 1000)) {
+         archive_append(frame->fb->buf, frame->fb->len, now);
+         lastAppend = now;
+      }
+      BC_ReleaseFrame(frame);
+   }
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t Archive_Init(void) {
+   ringSize = (size_t)CONFIG_ARCHIVE_SIZE_KB * 1024;
+   ring = heap_caps_malloc(ringSize, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+   if (NULL == ring) {
+      ESP_LOGE(TAG, "Failed to allocate %u KB ring in PSRAM!", CONFIG_ARCHIVE_SIZE_KB);
+      return ESP_ERR_NO_MEM;
+   }
+
+   xLock = xSemaphoreCreateMutex();
+   if (NULL == xLock) {
+      ESP_LOGE(TAG, "Failed to create lock!");
+      return ESP_FAIL;
+   }
+
+   if (pdPASS != xTaskCreatePinnedToCore(task_archive, "Archive", ARCHIVE_TASK_STACK, NULL, TASK_PRIO_ARCHIVE, NULL,
+                                         TASK_CORE_CAPTURE)) {
+      ESP_LOGE(TAG, "Failed to create recorder task!");
+      return ESP_FAIL;
+   }
+
+   ESP_LOGI(TAG, "Init finished, %u KB ring", CONFIG_ARCHIVE_SIZE_KB);
+   return ESP_OK;
+}
+
+esp_err_t Archive_GetNext(int64_t *Timestamp, uint8_t **Buf, size_t *Len) {
+   esp_err_t res = ESP_ERR_NOT_FOUND;
+
+   if ((NULL == Timestamp) || (NULL == Buf) || (NULL == Len)) {
+      return ESP_ERR_INVALID_ARG;
+   }
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   for (uint16_t i = 0; i < recCount; i++) {
+      const record_t *rec = &records[(recFirst + i) % ARCHIVE_MAX_RECORDS];
+      if (rec->timestamp > *Timestamp) {
+         // Hand out a copy so the send does not block the recorder
+         *Buf = heap_caps_malloc(rec->len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+         if (NULL != *Buf) {
+            memcpy(*Buf, ring + rec->offset, rec->len);
+            *Len = rec->len;
+            *Timestamp = rec->timestamp;
+            res = ESP_OK;
+         } else {
+            res = ESP_ERR_NO_MEM;
+         }
+         break;
+      }
+   }
+   xSemaphoreGive(xLock);
+
+   return res;
+}
+
+uint16_t Archive_GetCount(void) { return recCount; }
+
+#endif   // CONFIG_ARCHIVE_ENABLE
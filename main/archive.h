@@ -0,0 +1,59 @@
+/**
+ ******************************************************************************
+ *  file           : archive.h
+ *  brief          : Circular frame archive in PSRAM for pre-roll retrieval
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef ARCHIVE_H_
+#define ARCHIVE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Init the archive ring and start the recorder task
+ *
+ * @return esp_err_t
+ */
+esp_err_t Archive_Init(void);
+
+/**
+ * @brief Get a copy of the oldest archived frame newer than a timestamp
+ *
+ * @param Timestamp In: lower bound [us since boot]; out: timestamp of the
+ *                  returned frame. Pass the updated value to iterate.
+ * @param Buf Receives the JPEG copy, caller frees with free()
+ * @param Len Receives the JPEG length
+ * @return esp_err_t, ESP_ERR_NOT_FOUND when no newer frame exists
+ */
+esp_err_t Archive_GetNext(int64_t *Timestamp, uint8_t **Buf, size_t *Len);
+
+/**
+ * @brief Get the number of frames currently archived
+ *
+ * @return uint16_t
+ */
+uint16_t Archive_GetCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // ARCHIVE_H_
@@ -0,0 +1,159 @@
+/**
+ ******************************************************************************
+ *  file           : bench.c
+ *  brief          : On-device benchmark scenarios for the capture pipeline
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "bench.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+#include <esp_camera.h>
+
+#include "camera.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt.h"
+#include "sdkconfig.h"
+#include "transcode.h"
+
+#ifdef CONFIG_BENCH_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+
+// Per-stage duration statistics, microseconds
+typedef struct {
+   uint32_t count;
+   uint32_t min_us;
+   uint32_t max_us;
+   uint64_t sum_us;
+} stage_stats_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define TRANSCODE_DIVIDER 4   // Transcode runs on every Nth iteration, it is slow
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "BENCH";
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void stage_record(stage_stats_t *s, int64_t start);
+static int stage_print(char *out, size_t outLen, const char *name, const stage_stats_t *s);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Record one sample ending now
+ */
+static void stage_record(stage_stats_t *s, int64_t start) {
+   const uint32_t us = (uint32_t)(esp_timer_get_time() - start);
+   if ((0 == s->count) || (us < s->min_us)) {
+      s->min_us = us;
+   }
+   if (us > s->max_us) {
+      s->max_us = us;
+   }
+   s->sum_us += us;
+   s->count++;
+}
+
+/**
+ * @brief Append one stage as a JSON object ("name":{...})
+ */
+static int stage_print(char *out, size_t outLen, const char *name, const stage_stats_t *s) {
+   const uint32_t avg = (s->count > 0) ? (uint32_t)(s->sum_us / s->count) : 0;
+   return snprintf(out, outLen,
+                   "\"%s\":{\"count\":%" PRIu32 ",\"min_us\":%" PRIu32 ",\"avg_us\":%" PRIu32 ",\"max_us\":%" PRIu32
+                   "}",
+                   name, s->count, s->min_us, avg, s->max_us);
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t Bench_Run(uint32_t Iterations, char *Out, size_t OutLen) {
+   stage_stats_t capture = {0};
+   stage_stats_t transcode = {0};
+   stage_stats_t enqueue = {0};
+   uint64_t bytes = 0;
+
+   if ((NULL == Out) || (0 == OutLen)) {
+      return ESP_ERR_INVALID_ARG;
+   }
+   if ((0 == Iterations) || (Iterations > BENCH_MAX_ITERATIONS)) {
+      Iterations = BENCH_MAX_ITERATIONS;
+   }
+   if (!CAM_WaitReady(pdMS_TO_TICKS(5000))) {
+      return ESP_FAIL;
+   }
+
+   ESP_LOGI(TAG, "Running %" PRIu32 " iterations, profile '%s'", Iterations, CAM_GetProfileName(CAM_GetProfile()));
+   MQTT_Topic *topic = MQTT_isConnected() ? MQTT_RegisterTopic("Bench", 0, false) : NULL;
+
+   for (uint32_t i = 0; i < Iterations; i++) {
+      int64_t start = esp_timer_get_time();
+      camera_fb_t *fb = esp_camera_fb_get();
+      if (NULL == fb) {
+         continue;
+      }
+      stage_record(&capture, start);
+      bytes += fb->len;
+
+      if (0 == (i % TRANSCODE_DIVIDER)) {
+         uint8_t *jpg = NULL;
+         size_t jpg_len = 0;
+         start = esp_timer_get_time();
+         if (ESP_OK == Transcode_JpegScale(fb, JPG_SCALE_4X, 40, &jpg, &jpg_len)) {
+            stage_record(&transcode, start);
+            free(jpg);
+         }
+      }
+
+      if (NULL != topic) {
+         start = esp_timer_get_time();
+         if (ESP_OK == MQTT_Publish(topic, "bench", 0)) {
+            stage_record(&enqueue, start);
+         }
+      }
+
+      esp_camera_fb_return(fb);
+   }
+
+   if (0 == capture.count) {
+      ESP_LOGE(TAG, "No frames captured");
+      return ESP_FAIL;
+   }
+
+   // Sustainable capture rate and frame size over the run
+   const uint32_t fps100 = (uint32_t)((uint64_t)capture.count * 100000000ULL / capture.sum_us);
+   size_t used = snprintf(Out, OutLen,
+                          "{\"profile\":\"%s\",\"iterations\":%" PRIu32 ",\"fps\":%" PRIu32 ".%02" PRIu32
+                          ",\"avg_bytes\":%" PRIu32 ",",
+                          CAM_GetProfileName(CAM_GetProfile()), Iterations, fps100 / 100, fps100 % 100,
+                          (uint32_t)(bytes / capture.count));
+   used += stage_print(Out + used, (used < OutLen) ? OutLen - used : 0, "capture", &capture);
+   used += snprintf(Out + used, (used < OutLen) ? OutLen - used : 0, ",");
+   used += stage_print(Out + used, (used < OutLen) ? OutLen - used : 0, "transcode", &transcode);
+   used += snprintf(Out + used, (used < OutLen) ? OutLen - used : 0, ",");
+   used += stage_print(Out + used, (used < OutLen) ? OutLen - used : 0, "mqtt_enqueue", &enqueue);
+   used += snprintf(Out + used, (used < OutLen) ? OutLen - used : 0, "}");
+   if (used >= OutLen) {
+      return ESP_ERR_NO_MEM;
+   }
+
+   ESP_LOGI(TAG, "Done: %" PRIu32 ".%02" PRIu32 " fps", fps100 / 100, fps100 % 100);
+   return ESP_OK;
+}
+
+#endif   // CONFIG_BENCH_ENABLE
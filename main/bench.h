@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ *  file           : bench.h
+ *  brief          : On-device benchmark scenarios for the capture pipeline
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+#define BENCH_MAX_ITERATIONS 256
+#define BENCH_RESULT_SIZE    1024   // Buffer size for the JSON report
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Run the benchmark scenarios and report the results as JSON
+ *
+ * Times N capture iterations, the MQTT-sized transcode and the publish
+ * enqueue per stage (min/avg/max in us). Run without active stream
+ * clients for comparable numbers across releases.
+ *
+ * @param Iterations Capture iterations (clamped to BENCH_MAX_ITERATIONS)
+ * @param Out Output buffer for the JSON report
+ * @param OutLen Size of the buffer (BENCH_RESULT_SIZE recommended)
+ * @return esp_err_t
+ */
+esp_err_t Bench_Run(uint32_t Iterations, char *Out, size_t OutLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // BENCH_H_
@@ -0,0 +1,357 @@
+/**
+ ******************************************************************************
+ *  file           : broadcast.c
+ *  brief          : Frame broadcaster: single capture, multi-client fan-out
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "broadcast.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+#include "camera.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "perfmon.h"
+#include "pmlock.h"
+#include "taskcfg.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+struct BC_Client {
+   bool inUse;            // Slot is taken
+   uint32_t intervalMs;   // Desired frame interval, 0 = full sensor rate
+   QueueHandle_t queue;   // Queue of BC_Frame*, depth 1: a client only ever sees the latest frame
+};
+
+/**
+ * @brief Backing store of a frame slot: a PSRAM copy of the JPEG plus the
+ *        camera_fb_t header handed to clients via BC_Frame.fb. Copying
+ *        decouples slow senders from the few driver framebuffers - the
+ *        driver fb is returned right after capture, so a viewer stalled in
+ *        a send can never starve the capture loop.
+ */
+typedef struct {
+   camera_fb_t meta;   // Header for the copy, buf points into this slot
+   uint8_t *buf;       // PSRAM copy of the JPEG
+   size_t capacity;    // Allocated size of buf, grown on demand
+} frame_slot_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define BC_MAX_FRAMES    4      // Frames in flight (capture + clients still sending)
+#define BC_IDLE_DELAY    100    // [ms] Poll cycle while no client is connected
+#define BC_FAIL_DELAY    500    // [ms] Back-off after a failed capture
+#define BC_TASK_STACK    4096   // Stack size of the capture task
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "BCAST";
+
+static BC_Frame framePool[BC_MAX_FRAMES];
+static frame_slot_t frameSlots[BC_MAX_FRAMES];
+static struct BC_Client clients[BC_MAX_CLIENTS];
+static SemaphoreHandle_t xLock = NULL;   // Protects clients, frame pool and ref counters
+static uint8_t clientCount = 0;
+static uint8_t fullRateCount = 0;   // Clients wanting full sensor rate (interval 0)
+static uint32_t frameCount = 0;     // Frames captured since boot
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_capture(void *pvParameters);
+static BC_Frame *frame_alloc(camera_fb_t *fb);
+static uint32_t min_interval(void);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Copy a captured frame into a free slot. Caller holds one reference
+ *        and can return the driver framebuffer immediately afterwards.
+ */
+static BC_Frame *frame_alloc(camera_fb_t *fb) {
+   BC_Frame *frame = NULL;
+   frame_slot_t *slot = NULL;
+
+   // Reserve a slot; nobody else touches it until the fan-out, so the
+   // bulky copy happens outside the lock
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   for (uint8_t i = 0; i < BC_MAX_FRAMES; i++) {
+      if (NULL == framePool[i].fb) {
+         slot = &frameSlots[i];
+         framePool[i].fb = &slot->meta;
+         framePool[i].refs = 1;
+         frame = &framePool[i];
+         break;
+      }
+   }
+   xSemaphoreGive(xLock);
+
+   if (NULL == frame) {
+      return NULL;
+   }
+
+   // Grow the PSRAM copy buffer on demand, it is kept for reuse
+   if (slot->capacity < fb->len) {
+      free(slot->buf);
+      slot->buf = heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM);
+      if (NULL == slot->buf) {
+         ESP_LOGE(TAG, "Failed to allocate %u bytes for frame copy", fb->len);
+         slot->capacity = 0;
+         frame->fb = NULL;
+         return NULL;
+      }
+      slot->capacity = fb->len;
+   }
+
+   memcpy(slot->buf, fb->buf, fb->len);
+   slot->meta = *fb;
+   slot->meta.buf = slot->buf;
+
+   return frame;
+}
+
+/**
+ * @brief Fastest frame interval any active client needs
+ *
+ * @return Interval in ms, 0 for full rate, UINT32_MAX without clients
+ */
+static uint32_t min_interval(void) {
+   uint32_t interval = UINT32_MAX;
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   for (uint8_t i = 0; i < BC_MAX_CLIENTS; i++) {
+      if (clients[i].inUse && (clients[i].intervalMs < interval)) {
+         interval = clients[i].intervalMs;
+      }
+   }
+   xSemaphoreGive(xLock);
+
+   return interval;
+}
+
+/**
+ * @brief Task: Grab frames from the camera and fan them out to all clients
+ */
+static void task_capture(void *pvParameters) {
+   int64_t lastCapture = 0;
+
+   // Camera init runs in parallel with startup, block until it delivers
+   while (!CAM_WaitReady(pdMS_TO_TICKS(1000))) {
+      ESP_LOGI(TAG, "Waiting for the camera");
+   }
+
+   while (1) {
+      const uint32_t interval = min_interval();
+      if (UINT32_MAX == interval) {
+         vTaskDelay(pdMS_TO_TICKS(BC_IDLE_DELAY));
+         continue;
+      }
+
+      // Pace to the fastest interval any client needs: a background
+      // recorder alone does not drive the sensor at full rate. Sleep in
+      // short slices so a newly registered full-rate client is picked up
+      // within one slice
+      if (interval > 0) {
+         const int64_t due = lastCapture + ((int64_t)interval * 1000);
+         const int64_t now = esp_timer_get_time();
+         if (now < due) {
+            uint32_t waitMs = (uint32_t)((due - now) / 1000) + 1;
+            if (waitMs > BC_IDLE_DELAY) {
+               waitMs = BC_IDLE_DELAY;
+            }
+            vTaskDelay(pdMS_TO_TICKS(waitMs));
+            continue;
+         }
+      }
+
+      const int64_t captureStart = PERF_TimerStart();
+      camera_fb_t *fb = esp_camera_fb_get();
+      if (NULL == fb) {
+         ESP_LOGE(TAG, "Camera capture failed");
+         vTaskDelay(pdMS_TO_TICKS(BC_FAIL_DELAY));
+         continue;
+      }
+      PERF_TimerStop(PERF_TIMER_CAPTURE, captureStart);
+      lastCapture = esp_timer_get_time();
+      if (fb->format != PIXFORMAT_JPEG) {
+         // The broadcaster shares one buffer between clients and does not convert
+         ESP_LOGW(TAG, "Framebuffer format 0x%02x not supported, dropping frame", fb->format);
+         esp_camera_fb_return(fb);
+         continue;
+      }
+
+      frameCount++;
+      PERF_Add(PERF_CNT_FRAMES_CAPTURED, 1);
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+      CAM_TuneOutputSize(fb->len);
+#endif
+
+      BC_Frame *frame = frame_alloc(fb);
+      // The copy is made, hand the driver buffer back right away so the
+      // next capture never waits on a slow client
+      esp_camera_fb_return(fb);
+      if (NULL == frame) {
+         // All slots held by slow clients (or copy failed), drop this frame
+         PERF_Add(PERF_CNT_FRAMES_DROPPED, 1);
+         continue;
+      }
+
+      // Hand the frame to every client; a stale undelivered frame is replaced
+      xSemaphoreTake(xLock, portMAX_DELAY);
+      for (uint8_t i = 0; i < BC_MAX_CLIENTS; i++) {
+         if (!clients[i].inUse) {
+            continue;
+         }
+         frame->refs++;
+         if (pdTRUE != xQueueSend(clients[i].queue, &frame, 0)) {
+            BC_Frame *stale = NULL;
+            if (pdTRUE == xQueueReceive(clients[i].queue, &stale, 0)) {
+               stale->refs--;
+               if (0 == stale->refs) {
+                  stale->fb = NULL;   // Slot free, copy buffer is reused
+               }
+            }
+            if (pdTRUE != xQueueSend(clients[i].queue, &frame, 0)) {
+               frame->refs--;
+            }
+         }
+      }
+      xSemaphoreGive(xLock);
+
+      // Drop the capture reference
+      BC_ReleaseFrame(frame);
+   }
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t BC_Init(void) {
+   xLock = xSemaphoreCreateMutex();
+   if (NULL == xLock) {
+      ESP_LOGE(TAG, "Failed to create lock!");
+      return ESP_FAIL;
+   }
+
+   memset(&framePool[0], 0x00, sizeof(framePool));
+   memset(&frameSlots[0], 0x00, sizeof(frameSlots));
+   memset(&clients[0], 0x00, sizeof(clients));
+
+   for (uint8_t i = 0; i < BC_MAX_CLIENTS; i++) {
+      clients[i].queue = xQueueCreate(1, sizeof(BC_Frame *));
+      if (NULL == clients[i].queue) {
+         ESP_LOGE(TAG, "Failed to create client queue!");
+         return ESP_FAIL;
+      }
+   }
+
+   if (pdPASS !=
+       xTaskCreatePinnedToCore(task_capture, "Cam Capture", BC_TASK_STACK, NULL, TASK_PRIO_CAPTURE, NULL,
+                               TASK_CORE_CAPTURE)) {
+      ESP_LOGE(TAG, "Failed to create capture task!");
+      return ESP_FAIL;
+   }
+
+   ESP_LOGI(TAG, "Init finished");
+   return ESP_OK;
+}
+
+BC_Client *BC_Register(uint32_t IntervalMs) {
+   BC_Client *client = NULL;
+   bool firstFullRate = false;
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   for (uint8_t i = 0; i < BC_MAX_CLIENTS; i++) {
+      if (!clients[i].inUse) {
+         clients[i].inUse = true;
+         clients[i].intervalMs = IntervalMs;
+         clientCount++;
+         if (0 == IntervalMs) {
+            fullRateCount++;
+            firstFullRate = (1 == fullRateCount);
+         }
+         client = &clients[i];
+         break;
+      }
+   }
+   xSemaphoreGive(xLock);
+
+   if (NULL == client) {
+      ESP_LOGW(TAG, "No free client slot!");
+   } else {
+      if (firstFullRate) {
+         // First full-rate client: hold full clock while it streams.
+         // Paced background recorders run fine at scaled clocks and do
+         // not pin the CPU
+         PM_AcquireCapture();
+      }
+      ESP_LOGI(TAG, "Client registered, %d active", clientCount);
+   }
+   return client;
+}
+
+void BC_Unregister(BC_Client *Client) {
+   bool lastFullRate = false;
+
+   if (NULL == Client) {
+      return;
+   }
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   Client->inUse = false;
+   clientCount--;
+   if (0 == Client->intervalMs) {
+      fullRateCount--;
+      lastFullRate = (0 == fullRateCount);
+   }
+   BC_Frame *stale = NULL;
+   if (pdTRUE == xQueueReceive(Client->queue, &stale, 0)) {
+      stale->refs--;
+      if (0 == stale->refs) {
+         stale->fb = NULL;   // Slot free, copy buffer is reused
+      }
+   }
+   xSemaphoreGive(xLock);
+
+   if (lastFullRate) {
+      PM_ReleaseCapture();
+   }
+   ESP_LOGI(TAG, "Client unregistered, %d active", clientCount);
+}
+
+BC_Frame *BC_WaitFrame(BC_Client *Client, TickType_t xTicksToWait) {
+   BC_Frame *frame = NULL;
+
+   if (NULL == Client) {
+      return NULL;
+   }
+   if (pdTRUE != xQueueReceive(Client->queue, &frame, xTicksToWait)) {
+      return NULL;
+   }
+   return frame;
+}
+
+void BC_ReleaseFrame(BC_Frame *Frame) {
+   if (NULL == Frame) {
+      return;
+   }
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   Frame->refs--;
+   if (0 == Frame->refs) {
+      Frame->fb = NULL;   // Slot free, copy buffer is reused
+   }
+   xSemaphoreGive(xLock);
+}
+
+uint8_t BC_GetClientCount(void) { return clientCount; }
+
+uint32_t BC_GetFrameCount(void) { return frameCount; }
@@ -0,0 +1,108 @@
+/**
+ ******************************************************************************
+ *  file           : broadcast.h
+ *  brief          : Frame broadcaster: single capture, multi-client fan-out
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef BROADCAST_H_
+#define BROADCAST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <esp_camera.h>
+
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+#define BC_MAX_CLIENTS 6   // Max number of simultaneous stream clients
+
+/* Exported types ------------------------------------------------------------*/
+
+/**
+ * @brief A captured frame shared between clients. fb points at a
+ *        broadcaster-owned PSRAM copy - the driver framebuffer is returned
+ *        right after capture - and the slot is recycled when the last
+ *        reference is released.
+ */
+typedef struct BC_Frame {
+   camera_fb_t *fb;   // Broadcaster-owned copy of the captured frame
+   uint8_t refs;      // Reference counter, slot is recycled at 0
+} BC_Frame;
+
+typedef struct BC_Client BC_Client;   // Opaque per-client handle
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Init the broadcaster and start the capture task
+ *
+ * @return esp_err_t
+ */
+esp_err_t BC_Init(void);
+
+/**
+ * @brief Register a stream client with the broadcaster
+ *
+ * The capture loop paces itself to the fastest interval any client
+ * needs, so background recorders alone do not drive the sensor at full
+ * rate. Only full-rate clients hold the power-management capture locks.
+ *
+ * @param IntervalMs Desired frame interval in ms, 0 for full sensor rate
+ * @return Client handle, or NULL if all slots are taken
+ */
+BC_Client *BC_Register(uint32_t IntervalMs);
+
+/**
+ * @brief Unregister a client and release any pending frame
+ *
+ * @param Client The client handle
+ */
+void BC_Unregister(BC_Client *Client);
+
+/**
+ * @brief Wait for the next frame for this client
+ *
+ * @param Client The client handle
+ * @param xTicksToWait Max time to wait for a frame
+ * @return The frame (release with BC_ReleaseFrame), or NULL on timeout
+ */
+BC_Frame *BC_WaitFrame(BC_Client *Client, TickType_t xTicksToWait);
+
+/**
+ * @brief Release a reference to a frame
+ *
+ * @param Frame The frame to release
+ */
+void BC_ReleaseFrame(BC_Frame *Frame);
+
+/**
+ * @brief Get the number of registered clients
+ *
+ * @return uint8_t
+ */
+uint8_t BC_GetClientCount(void);
+
+/**
+ * @brief Get the number of frames captured since boot
+ *
+ * @return uint32_t
+ */
+uint32_t BC_GetFrameCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // BROADCAST_H_
@@ -0,0 +1,134 @@
+/**
+ ******************************************************************************
+ *  file           : bufpool.c
+ *  brief          : Size-classed PSRAM pool for conversion buffers
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "bufpool.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "perfmon.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   uint8_t *buf;   // Preallocated PSRAM buffer
+   size_t size;    // Class size of the buffer
+   bool inUse;
+} pool_entry_t;
+
+/* Private define ------------------------------------------------------------*/
+
+// Sized for the transcode RGB planes (quarter-scale SXGA is ~245 KB) and
+// the WebSocket staging buffers; two per class covers one stream client
+// plus the MQTT publish path running concurrently
+#define CLASS_SMALL  (64 * 1024)
+#define CLASS_LARGE  (320 * 1024)
+#define COUNT_SMALL  2
+#define COUNT_LARGE  2
+#define POOL_ENTRIES (COUNT_SMALL + COUNT_LARGE)
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "BUFPOOL";
+
+static pool_entry_t pool[POOL_ENTRIES];
+static SemaphoreHandle_t xLock = NULL;   // Protects the pool bookkeeping
+static uint32_t inUseCount = 0;          // Pool and fallback buffers currently out
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private user code ---------------------------------------------------------*/
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t BufPool_Init(void) {
+   xLock = xSemaphoreCreateMutex();
+   if (NULL == xLock) {
+      ESP_LOGE(TAG, "Failed to create lock!");
+      return ESP_FAIL;
+   }
+
+   memset(&pool[0], 0x00, sizeof(pool));
+   for (int i = 0; i < POOL_ENTRIES; i++) {
+      const size_t size = (i < COUNT_SMALL) ? CLASS_SMALL : CLASS_LARGE;
+      pool[i].buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (NULL == pool[i].buf) {
+         ESP_LOGE(TAG, "Failed to preallocate %u bytes!", (unsigned)size);
+         return ESP_ERR_NO_MEM;
+      }
+      pool[i].size = size;
+   }
+
+   ESP_LOGI(TAG, "Pool ready: %dx%uK + %dx%uK", COUNT_SMALL, CLASS_SMALL / 1024, COUNT_LARGE, CLASS_LARGE / 1024);
+   return ESP_OK;
+}
+
+void *BufPool_Acquire(size_t Size) {
+   void *buf = NULL;
+
+   if (NULL != xLock) {
+      xSemaphoreTake(xLock, portMAX_DELAY);
+      // Smallest fitting class first; entries are ordered by size
+      for (int i = 0; i < POOL_ENTRIES; i++) {
+         if (!pool[i].inUse && (pool[i].size >= Size)) {
+            pool[i].inUse = true;
+            buf = pool[i].buf;
+            break;
+         }
+      }
+      if (NULL != buf) {
+         inUseCount++;
+         PERF_Max(PERF_CNT_CONV_BUFFERS_HW, inUseCount);
+      }
+      xSemaphoreGive(xLock);
+   }
+
+   if (NULL == buf) {
+      // Oversized request or pool exhausted: fall back to the heap
+      PERF_Add(PERF_CNT_CONV_POOL_MISSES, 1);
+      buf = heap_caps_malloc(Size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      if (NULL != buf) {
+         xSemaphoreTake(xLock, portMAX_DELAY);
+         inUseCount++;
+         PERF_Max(PERF_CNT_CONV_BUFFERS_HW, inUseCount);
+         xSemaphoreGive(xLock);
+      }
+   }
+   return buf;
+}
+
+void BufPool_Release(void *Buf) {
+   if ((NULL == Buf) || (NULL == xLock)) {
+      return;
+   }
+
+   xSemaphoreTake(xLock, portMAX_DELAY);
+   bool pooled = false;
+   for (int i = 0; i < POOL_ENTRIES; i++) {
+      if (pool[i].buf == Buf) {
+         pool[i].inUse = false;
+         pooled = true;
+         break;
+      }
+   }
+   inUseCount--;
+   xSemaphoreGive(xLock);
+
+   if (!pooled) {
+      free(Buf);
+   }
+}
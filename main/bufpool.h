@@ -0,0 +1,60 @@
+/**
+ ******************************************************************************
+ *  file           : bufpool.h
+ *  brief          : Size-classed PSRAM pool for conversion buffers
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef BUFPOOL_H_
+#define BUFPOOL_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Preallocate the pool buffers in PSRAM
+ *
+ * @return esp_err_t
+ */
+esp_err_t BufPool_Init(void);
+
+/**
+ * @brief Take a buffer of at least Size bytes from the pool
+ *
+ * Served from the smallest fitting size class; when the pool cannot
+ * serve the request it falls back to the heap (counted as a pool miss),
+ * so callers never have to handle exhaustion.
+ *
+ * @param Size Requested size in bytes
+ * @return Buffer, or NULL if even the heap fallback failed
+ */
+void *BufPool_Acquire(size_t Size);
+
+/**
+ * @brief Return a buffer to the pool
+ *
+ * @param Buf The buffer from BufPool_Acquire (NULL is ignored)
+ */
+void BufPool_Release(void *Buf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // BUFPOOL_H_
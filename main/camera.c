@@ -0,0 +1,305 @@
+/**
+ ******************************************************************************
+ *  file           : camera.c
+ *  brief          : Camera init and runtime profile switching
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "camera.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
+#include "freertos/task.h"
+#include "taskcfg.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   const char *name;        // Profile name for MQTT/HTTP switching
+   framesize_t framesize;   // Sensor output size
+   uint8_t quality;         // JPEG quality (lower is better)
+} cam_profile_def_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define CAM_READY_BIT BIT0   // Set once the sensor delivers frames
+
+#define SENSOR_ACTIVE_W 1600   // Active pixel array of the sensor
+#define SENSOR_ACTIVE_H 1200
+#define WINDOW_ALIGN    4     // Window coordinates are aligned to this
+#define WINDOW_MIN      96    // Smallest accepted window edge
+
+#define CAM_PIN_RESET 5
+#define CAM_PIN_XCLK  15
+#define CAM_PIN_SIOD  22
+#define CAM_PIN_SIOC  23
+#define CAM_PIN_D7    39
+#define CAM_PIN_D6    34
+#define CAM_PIN_D5    33
+#define CAM_PIN_D4    27
+#define CAM_PIN_D3    12
+#define CAM_PIN_D2    35
+#define CAM_PIN_D1    14
+#define CAM_PIN_D0    2
+#define CAM_PIN_VSYNC 18
+#define CAM_PIN_HREF  36
+#define CAM_PIN_PCLK  26
+
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+#define TUNE_ADJUST_FRAMES 8    // Frames between quality adjustments
+#define TUNE_QUALITY_MAX   40   // Coarsest quality the tuner may select
+#define TUNE_DEADBAND_PCT  10   // No adjustment within this band around the budget
+#endif
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "CAM";
+
+static EventGroupHandle_t xReadyEvent = NULL;
+
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+static size_t tuneEwmaLen = 0;    // EWMA of the encoded frame size
+static int tuneQuality = -1;      // Quality currently set by the tuner, -1 = profile default
+static uint8_t tuneFrames = 0;    // Frames since the last adjustment
+#endif
+
+static const cam_profile_def_t profiles[CAM_PROFILE_MAX] = {
+    [CAM_PROFILE_LOWLAT] = {.name = "lowlat", .framesize = FRAMESIZE_QVGA, .quality = 10},
+    [CAM_PROFILE_BALANCED] = {.name = "balanced", .framesize = FRAMESIZE_VGA, .quality = 8},
+    [CAM_PROFILE_ARCHIVAL] = {.name = "archival", .framesize = FRAMESIZE_SXGA, .quality = 5},
+};
+
+static CAM_Profile activeProfile = CAM_PROFILE_ARCHIVAL;
+
+static camera_config_t camera_config = {
+    .pin_pwdn = -1,   // Unused
+    .pin_reset = CAM_PIN_RESET,
+    .pin_xclk = CAM_PIN_XCLK,
+    .pin_sccb_sda = CAM_PIN_SIOD,
+    .pin_sccb_scl = CAM_PIN_SIOC,
+    .pin_d7 = CAM_PIN_D7,
+    .pin_d6 = CAM_PIN_D6,
+    .pin_d5 = CAM_PIN_D5,
+    .pin_d4 = CAM_PIN_D4,
+    .pin_d3 = CAM_PIN_D3,
+    .pin_d2 = CAM_PIN_D2,
+    .pin_d1 = CAM_PIN_D1,
+    .pin_d0 = CAM_PIN_D0,
+    .pin_vsync = CAM_PIN_VSYNC,
+    .pin_href = CAM_PIN_HREF,
+    .pin_pclk = CAM_PIN_PCLK,
+    .xclk_freq_hz = 16000000,   // 16 MHz
+    .ledc_timer = LEDC_TIMER_0,
+    .ledc_channel = LEDC_CHANNEL_0,
+    .pixel_format = PIXFORMAT_JPEG,
+    .frame_size = FRAMESIZE_SXGA,
+    .jpeg_quality = 5,
+    .fb_count = CONFIG_CAM_FB_COUNT,
+    .fb_location = CAMERA_FB_IN_PSRAM,
+#ifdef CONFIG_CAM_GRAB_LATEST
+    .grab_mode = CAMERA_GRAB_LATEST,
+#else
+    .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
+#endif
+};
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_init(void *pvParameters);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Task: Probe and init the sensor while the network comes up
+ *
+ * Sensor probe, DMA setup and the warm-up capture take a sizeable part
+ * of the boot time; running them here instead of in app_main takes them
+ * off the WiFi/MQTT critical path. Self-deletes when done.
+ *
+ * @param pvParameters unused
+ */
+static void task_init(void *pvParameters) {
+   if (ESP_OK == CAM_Init()) {
+      // Warm-up capture: primes DMA and exposure before the first client
+      camera_fb_t *fb = esp_camera_fb_get();
+      if (NULL != fb) {
+         esp_camera_fb_return(fb);
+      }
+      xEventGroupSetBits(xReadyEvent, CAM_READY_BIT);
+   } else {
+      ESP_LOGE(TAG, "Camera init failed, frames unavailable!");
+   }
+   vTaskDelete(NULL);
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t CAM_Init(void) {
+   esp_err_t ret = esp_camera_init(&camera_config);
+   if (ESP_OK != ret) {
+      return ret;
+   }
+   ESP_LOGI(TAG, "Init finished, profile '%s'", profiles[activeProfile].name);
+   return ESP_OK;
+}
+
+esp_err_t CAM_InitAsync(void) {
+   xReadyEvent = xEventGroupCreate();
+   if (NULL == xReadyEvent) {
+      ESP_LOGE(TAG, "Failed to create ready event!");
+      return ESP_FAIL;
+   }
+   if (pdPASS != xTaskCreatePinnedToCore(task_init, "Cam Init", 4096, NULL, TASK_PRIO_CAPTURE, NULL,
+                                         TASK_CORE_CAPTURE)) {
+      ESP_LOGE(TAG, "Failed to create init task!");
+      return ESP_FAIL;
+   }
+   return ESP_OK;
+}
+
+bool CAM_WaitReady(TickType_t xTicksToWait) {
+   if (NULL == xReadyEvent) {
+      return false;
+   }
+   return (0 != (xEventGroupWaitBits(xReadyEvent, CAM_READY_BIT, pdFALSE, pdTRUE, xTicksToWait) & CAM_READY_BIT));
+}
+
+esp_err_t CAM_ApplyProfile(CAM_Profile Profile) {
+   if (Profile >= CAM_PROFILE_MAX) {
+      return ESP_ERR_INVALID_ARG;
+   }
+
+   sensor_t *s = esp_camera_sensor_get();
+   if (NULL == s) {
+      ESP_LOGE(TAG, "No sensor handle!");
+      return ESP_FAIL;
+   }
+
+   // Frame buffers are sized for the init-time frame size, smaller
+   // profiles reuse them without reallocation
+   if (0 != s->set_framesize(s, profiles[Profile].framesize)) {
+      ESP_LOGE(TAG, "Failed to set frame size for profile '%s'", profiles[Profile].name);
+      return ESP_FAIL;
+   }
+   if (0 != s->set_quality(s, profiles[Profile].quality)) {
+      ESP_LOGE(TAG, "Failed to set quality for profile '%s'", profiles[Profile].name);
+      return ESP_FAIL;
+   }
+
+   activeProfile = Profile;
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+   // The tuner restarts from the profile quality at the new resolution
+   tuneEwmaLen = 0;
+   tuneQuality = -1;
+   tuneFrames = 0;
+#endif
+   ESP_LOGI(TAG, "Applied profile '%s'", profiles[Profile].name);
+   return ESP_OK;
+}
+
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+void CAM_TuneOutputSize(size_t FrameLen) {
+   const size_t budget = (size_t)CONFIG_CAM_SIZE_BUDGET_KB * 1024;
+
+   tuneEwmaLen = (0 == tuneEwmaLen) ? FrameLen : ((7 * tuneEwmaLen + FrameLen) / 8);
+   if (++tuneFrames < TUNE_ADJUST_FRAMES) {
+      return;
+   }
+   tuneFrames = 0;
+
+   // One quality step per adjustment; the sensor reacts within a frame,
+   // larger steps oscillate on scene changes
+   int quality = (tuneQuality < 0) ? profiles[activeProfile].quality : tuneQuality;
+   if (tuneEwmaLen > (budget + (budget * TUNE_DEADBAND_PCT) / 100)) {
+      quality++;
+   } else if (tuneEwmaLen < (budget - (budget * TUNE_DEADBAND_PCT) / 100)) {
+      quality--;
+   } else {
+      return;
+   }
+
+   // Never finer than the profile asks for, never coarser than usable
+   if (quality < profiles[activeProfile].quality) {
+      quality = profiles[activeProfile].quality;
+   }
+   if (quality > TUNE_QUALITY_MAX) {
+      quality = TUNE_QUALITY_MAX;
+   }
+   if (quality == tuneQuality) {
+      return;
+   }
+
+   sensor_t *s = esp_camera_sensor_get();
+   if ((NULL == s) || (0 != s->set_quality(s, quality))) {
+      return;
+   }
+   tuneQuality = quality;
+   ESP_LOGI(TAG, "Autotune: %u KB avg, quality -> %d", (unsigned)(tuneEwmaLen / 1024), quality);
+}
+#endif   // CONFIG_CAM_SIZE_AUTOTUNE
+
+esp_err_t CAM_ApplyProfileByName(const char *Name) {
+   for (CAM_Profile i = 0; i < CAM_PROFILE_MAX; i++) {
+      if (0 == strcmp(Name, profiles[i].name)) {
+         return CAM_ApplyProfile(i);
+      }
+   }
+   ESP_LOGW(TAG, "Unknown profile '%s'", Name);
+   return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t CAM_SetWindow(uint16_t X, uint16_t Y, uint16_t W, uint16_t H) {
+   sensor_t *s = esp_camera_sensor_get();
+   if (NULL == s) {
+      ESP_LOGE(TAG, "No sensor handle!");
+      return ESP_FAIL;
+   }
+   if (NULL == s->set_res_raw) {
+      ESP_LOGW(TAG, "Sensor has no windowing support");
+      return ESP_ERR_NOT_SUPPORTED;
+   }
+
+   if ((W < WINDOW_MIN) || (H < WINDOW_MIN) || ((X + W) > SENSOR_ACTIVE_W) || ((Y + H) > SENSOR_ACTIVE_H) ||
+       (0 != (X % WINDOW_ALIGN)) || (0 != (Y % WINDOW_ALIGN)) || (0 != (W % WINDOW_ALIGN)) ||
+       (0 != (H % WINDOW_ALIGN))) {
+      return ESP_ERR_INVALID_ARG;
+   }
+
+   // The sensor reads out only the window: less DMA, smaller JPEGs and a
+   // frame rate that rises as the readout shrinks
+   if (0 != s->set_res_raw(s, 0, 0, 0, 0, X, Y, W, H, W, H, false, false)) {
+      ESP_LOGE(TAG, "Failed to set window %ux%u@%u,%u", (unsigned)W, (unsigned)H, (unsigned)X, (unsigned)Y);
+      return ESP_FAIL;
+   }
+
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+   // Frame sizes change completely, restart the tuner
+   tuneEwmaLen = 0;
+   tuneQuality = -1;
+   tuneFrames = 0;
+#endif
+   ESP_LOGI(TAG, "Window set to %ux%u@%u,%u", (unsigned)W, (unsigned)H, (unsigned)X, (unsigned)Y);
+   return ESP_OK;
+}
+
+esp_err_t CAM_ClearWindow(void) {
+   // Reapplying the profile restores the full-frame readout
+   return CAM_ApplyProfile(activeProfile);
+}
+
+CAM_Profile CAM_GetProfile(void) { return activeProfile; }
+
+const char *CAM_GetProfileName(CAM_Profile Profile) {
+   if (Profile >= CAM_PROFILE_MAX) {
+      return "unknown";
+   }
+   return profiles[Profile].name;
+}
@@ -0,0 +1,142 @@
+/**
+ ******************************************************************************
+ *  file           : camera.h
+ *  brief          : Camera init and runtime profile switching
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef CAMERA_H_
+#define CAMERA_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <esp_camera.h>
+
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/**
+ * @brief Pre-validated sensor profiles
+ */
+typedef enum {
+   CAM_PROFILE_LOWLAT = 0,   // QVGA, high frame rate, low bandwidth
+   CAM_PROFILE_BALANCED,     // VGA, dashboard streaming
+   CAM_PROFILE_ARCHIVAL,     // SXGA, full detail
+   CAM_PROFILE_MAX
+} CAM_Profile;
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Init the camera with the default (archival) profile
+ *
+ * @return esp_err_t
+ */
+esp_err_t CAM_Init(void);
+
+/**
+ * @brief Run camera init in its own task, parallel to network bring-up
+ *
+ * Returns once the init task is started; use CAM_WaitReady() before
+ * capturing.
+ *
+ * @return esp_err_t
+ */
+esp_err_t CAM_InitAsync(void);
+
+/**
+ * @brief Wait until the camera delivers frames
+ *
+ * @param xTicksToWait Max time to wait
+ * @return true if the camera is ready, false on timeout or failed init
+ */
+bool CAM_WaitReady(TickType_t xTicksToWait);
+
+/**
+ * @brief Switch to a profile at runtime via the sensor interface
+ *
+ * Applies frame size and JPEG quality through the sensor_t setters, no
+ * deinit/init cycle and no reboot.
+ *
+ * @param Profile The profile to apply
+ * @return esp_err_t
+ */
+esp_err_t CAM_ApplyProfile(CAM_Profile Profile);
+
+/**
+ * @brief Switch to a profile by its name ("lowlat", "balanced", "archival")
+ *
+ * @param Name The profile name
+ * @return esp_err_t, ESP_ERR_NOT_FOUND for an unknown name
+ */
+esp_err_t CAM_ApplyProfileByName(const char *Name);
+
+/**
+ * @brief Get the active profile
+ *
+ * @return CAM_Profile
+ */
+CAM_Profile CAM_GetProfile(void);
+
+/**
+ * @brief Restrict the sensor readout to a window of the pixel array
+ *
+ * Uses the sensor windowing registers, so only the region of interest is
+ * read out and encoded. Coordinates are aligned to 4 pixels within the
+ * 1600x1200 active array.
+ *
+ * @param X Window origin
+ * @param Y Window origin
+ * @param W Window width
+ * @param H Window height
+ * @return esp_err_t, ESP_ERR_NOT_SUPPORTED if the sensor lacks windowing
+ */
+esp_err_t CAM_SetWindow(uint16_t X, uint16_t Y, uint16_t W, uint16_t H);
+
+/**
+ * @brief Restore the full-frame readout of the active profile
+ *
+ * @return esp_err_t
+ */
+esp_err_t CAM_ClearWindow(void);
+
+#ifdef CONFIG_CAM_SIZE_AUTOTUNE
+/**
+ * @brief Feed an encoded frame size into the quality autotuner
+ *
+ * Tracks an average of recent frame sizes and steps the sensor JPEG
+ * quality to hold the output near CONFIG_CAM_SIZE_BUDGET_KB. Called
+ * from the capture path for every frame.
+ *
+ * @param FrameLen Encoded size of the captured frame in bytes
+ */
+void CAM_TuneOutputSize(size_t FrameLen);
+#endif
+
+/**
+ * @brief Get the name of a profile
+ *
+ * @param Profile The profile
+ * @return Profile name, or "unknown"
+ */
+const char *CAM_GetProfileName(CAM_Profile Profile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // CAMERA_H_
@@ -0,0 +1,134 @@
+/**
+ ******************************************************************************
+ *  file           : command.c
+ *  brief          : MQTT command dispatcher with registered handler routing
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "command.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "mqtt.h"
+#include "taskcfg.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   uint32_t hash;   // Precomputed subtopic hash, 0 = slot free
+   char SubTopic[MAX_SUBTOPIC_LEN];
+   CMD_Handler handler;
+} cmd_entry_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define CMD_MAX_HANDLERS 8
+#define CMD_TASK_STACK   4096
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "CMD";
+
+static cmd_entry_t handlers[CMD_MAX_HANDLERS];
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_dispatcher(void *pvParameters);
+static uint32_t subtopic_hash(const char *SubTopic);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief djb2 over the subtopic, never returns 0 (the free-slot marker)
+ */
+static uint32_t subtopic_hash(const char *SubTopic) {
+   uint32_t hash = 5381;
+   while ('\0' != *SubTopic) {
+      hash = (hash * 33) ^ (uint8_t)*SubTopic++;
+   }
+   return (0 == hash) ? 1 : hash;
+}
+
+/**
+ * @brief Task: Drain the RX queue and route messages to their handlers
+ *
+ * Incoming subtopics are hashed once and matched against the
+ * precomputed table; the strcmp only confirms a hash hit. Handlers run
+ * here, outside the MQTT event callback.
+ *
+ * @param pvParameters unused
+ */
+static void task_dispatcher(void *pvParameters) {
+   QueueHandle_t queue = MQTT_GetRxQueue();
+   MQTT_RXMessage *msg = NULL;
+
+   while (NULL == queue) {
+      // MQTT comes up in parallel, wait for its queue
+      vTaskDelay(pdMS_TO_TICKS(100));
+      queue = MQTT_GetRxQueue();
+   }
+
+   while (1) {
+      if (pdTRUE != xQueueReceive(queue, &msg, portMAX_DELAY)) {
+         continue;
+      }
+
+      const uint32_t hash = subtopic_hash(msg->SubTopic);
+      bool handled = false;
+      for (int i = 0; i < CMD_MAX_HANDLERS; i++) {
+         if ((handlers[i].hash == hash) && (0 == strcmp(handlers[i].SubTopic, msg->SubTopic))) {
+            handlers[i].handler(msg->SubTopic, msg->Payload, msg->PayloadLength);
+            handled = true;
+            break;
+         }
+      }
+      if (!handled) {
+         ESP_LOGW(TAG, "No handler for '%s'", msg->SubTopic);
+      }
+      MQTT_ReleaseRxMessage(msg);
+   }
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t CMD_Init(void) {
+   memset(&handlers[0], 0x00, sizeof(handlers));
+
+   if (pdPASS !=
+       xTaskCreatePinnedToCore(task_dispatcher, "MQTT Cmd", CMD_TASK_STACK, NULL, TASK_PRIO_MQTT, NULL,
+                               TASK_CORE_COMMS)) {
+      ESP_LOGE(TAG, "Failed to create dispatcher task!");
+      return ESP_FAIL;
+   }
+   return ESP_OK;
+}
+
+esp_err_t CMD_Register(const char *SubTopic, CMD_Handler Handler) {
+   if ((NULL == SubTopic) || (NULL == Handler) || (strlen(SubTopic) >= MAX_SUBTOPIC_LEN)) {
+      return ESP_ERR_INVALID_ARG;
+   }
+
+   for (int i = 0; i < CMD_MAX_HANDLERS; i++) {
+      if (0 == handlers[i].hash) {
+         snprintf(&handlers[i].SubTopic[0], MAX_SUBTOPIC_LEN, "%s", SubTopic);
+         handlers[i].handler = Handler;
+         handlers[i].hash = subtopic_hash(SubTopic);
+         ESP_LOGI(TAG, "Registered handler for '%s'", SubTopic);
+         return MQTT_Subscribe(SubTopic);
+      }
+   }
+
+   ESP_LOGE(TAG, "No free handler slot for '%s'!", SubTopic);
+   return ESP_ERR_NO_MEM;
+}
@@ -0,0 +1,58 @@
+/**
+ ******************************************************************************
+ *  file           : command.h
+ *  brief          : MQTT command dispatcher with registered handler routing
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef COMMAND_H_
+#define COMMAND_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/**
+ * @brief Handler for one command subtopic, runs in the dispatcher task
+ */
+typedef void (*CMD_Handler)(const char *SubTopic, const char *Payload, int PayloadLength);
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Start the dispatcher task draining the MQTT RX queue
+ *
+ * @return esp_err_t
+ */
+esp_err_t CMD_Init(void);
+
+/**
+ * @brief Register a handler and subscribe to its subtopic
+ *
+ * Routing uses a hash precomputed at registration, so dispatching does
+ * not strcmp every registered subtopic.
+ *
+ * @param SubTopic The subtopic below the base topic
+ * @param Handler Called with each message on the subtopic
+ * @return esp_err_t
+ */
+esp_err_t CMD_Register(const char *SubTopic, CMD_Handler Handler);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // COMMAND_H_
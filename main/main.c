@@ -7,22 +7,40 @@
  */
 
 /* Includes ------------------------------------------------------------------*/
-#include <cJSON.h>
 #include <esp_camera.h>
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/uio.h>
 #include <time.h>
 
 /* Private includes ----------------------------------------------------------*/
+#include "archive.h"
+#include "bench.h"
+#include "broadcast.h"
+#include "bufpool.h"
+#include "camera.h"
+#include "command.h"
+#include "config.h"
 #include "esp_camera.h"
 #include "esp_check.h"
 #include "esp_chip_info.h"
 #include "esp_err.h"
+#include "esp_heap_caps.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "lwip/sockets.h"
+#include "motion.h"
 #include "mqtt.h"
+#include "perfmon.h"
+#include "pmlock.h"
+#include "taskcfg.h"
+#include "timelapse.h"
+#include "transcode.h"
+#include "udpcast.h"
 #include "nvs_flash.h"
 #include "wifi.h"
 
@@ -33,28 +51,27 @@ typedef struct {
    size_t len;
 } jpg_chunking_t;
 
-/* Private define ------------------------------------------------------------*/
+typedef struct {
+   httpd_req_t *req;     // Async request handle owned by the session
+   BC_Client *client;    // Broadcaster registration
+   int fd;               // Raw socket of the connection
+} stream_session_t;
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+// Per-frame header preceding the JPEG in each binary WS frame
+typedef struct {
+   uint32_t seq;        // Frame sequence number, gaps mean dropped frames
+   int64_t timestamp;   // Send time in us since boot
+} __attribute__((packed)) ws_frame_hdr_t;
+#endif
 
-#define CAM_PIN_RESET 5
-#define CAM_PIN_XCLK  15
-#define CAM_PIN_SIOD  22
-#define CAM_PIN_SIOC  23
-#define CAM_PIN_D7    39
-#define CAM_PIN_D6    34
-#define CAM_PIN_D5    33
-#define CAM_PIN_D4    27
-#define CAM_PIN_D3    12
-#define CAM_PIN_D2    35
-#define CAM_PIN_D1    14
-#define CAM_PIN_D0    2
-#define CAM_PIN_VSYNC 18
-#define CAM_PIN_HREF  36
-#define CAM_PIN_PCLK  26
+/* Private define ------------------------------------------------------------*/
 
 #define PART_BOUNDARY "123456789000000000000987654321"
 
-#define TIME_MQTT_STATS (30 * 1000)   // [ms] Cycle time for MQTT stats
-#define TIME_MQTT_IMAGE (60 * 1000)   // [ms] Cycle time for MQTT image
+#define STATS_BUFFER_SIZE 512   // Preallocated buffer for the stats message
+
+#define STREAM_MAX_SKIP 10   // Max frames skipped after a slow send
 
 /* Private macro -------------------------------------------------------------*/
 
@@ -62,34 +79,23 @@ typedef struct {
 
 static const char *TAG = "MAIN";
 
-static camera_config_t camera_config = {
-    .pin_pwdn = -1,   // Unused
-    .pin_reset = CAM_PIN_RESET,
-    .pin_xclk = CAM_PIN_XCLK,
-    .pin_sccb_sda = CAM_PIN_SIOD,
-    .pin_sccb_scl = CAM_PIN_SIOC,
-    .pin_d7 = CAM_PIN_D7,
-    .pin_d6 = CAM_PIN_D6,
-    .pin_d5 = CAM_PIN_D5,
-    .pin_d4 = CAM_PIN_D4,
-    .pin_d3 = CAM_PIN_D3,
-    .pin_d2 = CAM_PIN_D2,
-    .pin_d1 = CAM_PIN_D1,
-    .pin_d0 = CAM_PIN_D0,
-    .pin_vsync = CAM_PIN_VSYNC,
-    .pin_href = CAM_PIN_HREF,
-    .pin_pclk = CAM_PIN_PCLK,
-    .xclk_freq_hz = 16000000,   // 16 MHz
-    .ledc_timer = LEDC_TIMER_0,
-    .ledc_channel = LEDC_CHANNEL_0,
-    .pixel_format = PIXFORMAT_JPEG,
-    .frame_size = FRAMESIZE_SXGA,
-    .jpeg_quality = 5,
-    .fb_count = 1,
-    .grab_mode = CAMERA_GRAB_WHEN_EMPTY,
-};
+#if CONFIG_SNAPSHOT_CACHE_TTL > 0
+static struct {
+   SemaphoreHandle_t lock;   // Guards the whole cache
+   uint8_t *buf;             // Cached JPEG in PSRAM
+   size_t len;
+   size_t capacity;
+   int64_t timestamp;   // Capture time [us since boot]
+   uint32_t etag;       // Incremented per fresh capture
+} snapCache;
+#endif
 
-static const char *_STREAM_CONTENT_TYPE = "multipart/x-mixed-replace;boundary=" PART_BOUNDARY;
+static MQTT_Topic *topicStatus = NULL;     // Cyclic stats, QoS 1
+static MQTT_Topic *topicSnapshot = NULL;   // Bulk images, QoS 0
+
+static const char *_STREAM_RESPONSE = "HTTP/1.1 200 OK\r\n"
+                                      "Content-Type: multipart/x-mixed-replace;boundary=" PART_BOUNDARY "\r\n"
+                                      "Connection: close\r\n\r\n";
 static const char *_STREAM_BOUNDARY = "\r\n--" PART_BOUNDARY "\r\n";
 static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n";
 
@@ -97,9 +103,27 @@ static const char *_STREAM_PART = "Content-Type: image/jpeg\r\nContent-Length: %
 
 static void task_mqtt_stats(void *pvParameters);
 static void task_mqtt_image(void *pvParameters);
+static void cmd_profile(const char *SubTopic, const char *Payload, int PayloadLength);
+static void cmd_capture(const char *SubTopic, const char *Payload, int PayloadLength);
+static void cmd_config(const char *SubTopic, const char *Payload, int PayloadLength);
 static size_t encode_jpg_stream(void *arg, size_t index, const void *data, size_t len);
 static esp_err_t stream_handler(httpd_req_t *req);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+static esp_err_t ws_handler(httpd_req_t *req);
+#endif
 static esp_err_t snapshot_handler(httpd_req_t *req);
+static esp_err_t profile_handler(httpd_req_t *req);
+static esp_err_t window_handler(httpd_req_t *req);
+#ifdef CONFIG_ARCHIVE_ENABLE
+static esp_err_t history_handler(httpd_req_t *req);
+#endif
+#ifdef CONFIG_TIMELAPSE_ENABLE
+static esp_err_t archive_handler(httpd_req_t *req);
+#endif
+#ifdef CONFIG_BENCH_ENABLE
+static esp_err_t bench_handler(httpd_req_t *req);
+#endif
+static esp_err_t metrics_handler(httpd_req_t *req);
 static httpd_handle_t start_webserver();
 
 /* Private user code ---------------------------------------------------------*/
@@ -115,6 +139,50 @@ static const httpd_uri_t uri_stream = {
     .method = HTTP_GET,
     .handler = stream_handler,
 };
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+static const httpd_uri_t uri_ws = {
+    .uri = "/ws",
+    .method = HTTP_GET,
+    .handler = ws_handler,
+    .is_websocket = true,
+};
+#endif
+static const httpd_uri_t uri_profile = {
+    .uri = "/profile",
+    .method = HTTP_GET,
+    .handler = profile_handler,
+};
+static const httpd_uri_t uri_window = {
+    .uri = "/window",
+    .method = HTTP_GET,
+    .handler = window_handler,
+};
+#ifdef CONFIG_ARCHIVE_ENABLE
+static const httpd_uri_t uri_history = {
+    .uri = "/history",
+    .method = HTTP_GET,
+    .handler = history_handler,
+};
+#endif
+#ifdef CONFIG_TIMELAPSE_ENABLE
+static const httpd_uri_t uri_archive = {
+    .uri = "/archive",
+    .method = HTTP_GET,
+    .handler = archive_handler,
+};
+#endif
+#ifdef CONFIG_BENCH_ENABLE
+static const httpd_uri_t uri_bench = {
+    .uri = "/bench",
+    .method = HTTP_GET,
+    .handler = bench_handler,
+};
+#endif
+static const httpd_uri_t uri_metrics = {
+    .uri = "/metrics",
+    .method = HTTP_GET,
+    .handler = metrics_handler,
+};
 
 /**
  * @brief  Callback to encode the JPEG stream
@@ -131,14 +199,128 @@ static size_t encode_jpg_stream(void *arg, size_t index, const void *data, size_
    return len;
 }
 
+#if CONFIG_SNAPSHOT_CACHE_TTL > 0
+/**
+ * @brief Refresh the snapshot cache if the cached frame is stale
+ *
+ * Called with the cache lock held.
+ */
+static esp_err_t snapshot_cache_refresh(void) {
+   const int64_t now = esp_timer_get_time();
+
+   if ((NULL != snapCache.buf) && ((now - snapCache.timestamp) < ((int64_t)CONFIG_SNAPSHOT_CACHE_TTL * 1000))) {
+      return ESP_OK;
+   }
+
+   camera_fb_t *fb = esp_camera_fb_get();
+   if (NULL == fb) {
+      return ESP_FAIL;
+   }
+   if (fb->format != PIXFORMAT_JPEG) {
+      esp_camera_fb_return(fb);
+      return ESP_ERR_NOT_SUPPORTED;
+   }
+
+   if (snapCache.capacity < fb->len) {
+      free(snapCache.buf);
+      snapCache.buf = heap_caps_malloc(fb->len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+      snapCache.capacity = (NULL != snapCache.buf) ? fb->len : 0;
+   }
+   if (NULL == snapCache.buf) {
+      esp_camera_fb_return(fb);
+      return ESP_ERR_NO_MEM;
+   }
+
+   memcpy(snapCache.buf, fb->buf, fb->len);
+   snapCache.len = fb->len;
+   snapCache.timestamp = now;
+   snapCache.etag++;
+   esp_camera_fb_return(fb);
+   return ESP_OK;
+}
+#endif   // CONFIG_SNAPSHOT_CACHE_TTL
+
 /**
  * @brief HTTP Request: Nahdle a JPG Snapshot
  */
 static esp_err_t snapshot_handler(httpd_req_t *req) {
-   camera_fb_t *fb = NULL;
    esp_err_t res = ESP_OK;
+   const int64_t snapStart = PERF_TimerStart();
+
+   // Right after boot the webserver may be up before the sensor is
+   if (!CAM_WaitReady(pdMS_TO_TICKS(5000))) {
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Camera not ready");
+      return ESP_FAIL;
+   }
+
+#if CONFIG_SNAPSHOT_CACHE_TTL > 0
+   char etag[24];
+   char reqEtag[24];
+
+   xSemaphoreTake(snapCache.lock, portMAX_DELAY);
+
+   PM_AcquireCapture();
+   res = snapshot_cache_refresh();
+   PM_ReleaseCapture();
+   if ((ESP_OK != res) && (ESP_ERR_NOT_SUPPORTED != res)) {
+      xSemaphoreGive(snapCache.lock);
+      ESP_LOGE(TAG, "SNAPSHOT: Camera capture failed");
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+   }
+
+   if (ESP_OK == res) {
+      snprintf(etag, sizeof(etag), "\"%" PRIu32 "\"", snapCache.etag);
+
+      // Unchanged poll: only headers go out
+      if (ESP_OK == httpd_req_get_hdr_value_str(req, "If-None-Match", reqEtag, sizeof(reqEtag))) {
+         if (0 == strcmp(etag, reqEtag)) {
+            xSemaphoreGive(snapCache.lock);
+            httpd_resp_set_status(req, "304 Not Modified");
+            httpd_resp_set_hdr(req, "ETag", etag);
+            res = httpd_resp_send(req, NULL, 0);
+            PERF_Add(PERF_CNT_SNAPSHOT_CACHE_HITS, 1);
+            PERF_TimerStop(PERF_TIMER_SNAPSHOT, snapStart);
+            return res;
+         }
+      }
+
+      // Snapshot the cache into a pool buffer and send outside the lock,
+      // so one slow client does not serialize every other /snapshot
+      const size_t sendLen = snapCache.len;
+      uint8_t *sendBuf = BufPool_Acquire(sendLen);
+      if (NULL == sendBuf) {
+         xSemaphoreGive(snapCache.lock);
+         ESP_LOGE(TAG, "SNAPSHOT: No buffer for the response");
+         httpd_resp_send_500(req);
+         return ESP_FAIL;
+      }
+      memcpy(sendBuf, snapCache.buf, sendLen);
+      xSemaphoreGive(snapCache.lock);
+
+      res = httpd_resp_set_type(req, "image/jpeg");
+      if (res == ESP_OK) {
+         res = httpd_resp_set_hdr(req, "Content-Disposition", "inline; filename=capture.jpg");
+      }
+      if (res == ESP_OK) {
+         res = httpd_resp_set_hdr(req, "ETag", etag);
+      }
+      if (res == ESP_OK) {
+         res = httpd_resp_send(req, (const char *)sendBuf, sendLen);
+      }
+      BufPool_Release(sendBuf);
+      PERF_Add(PERF_CNT_SNAPSHOTS, 1);
+      PERF_TimerStop(PERF_TIMER_SNAPSHOT, snapStart);
+      return res;
+   }
 
-   fb = esp_camera_fb_get();
+   // Non-JPEG sensor format: fall through to the uncached conversion path
+   xSemaphoreGive(snapCache.lock);
+#endif   // CONFIG_SNAPSHOT_CACHE_TTL
+
+   PM_AcquireCapture();
+   camera_fb_t *fb = esp_camera_fb_get();
+   PM_ReleaseCapture();
    if (!fb) {
       ESP_LOGE(TAG, "SNAPSHOT: Camera capture failed");
       httpd_resp_send_500(req);
@@ -159,65 +341,485 @@ static esp_err_t snapshot_handler(httpd_req_t *req) {
       }
    }
    esp_camera_fb_return(fb);
+   PERF_Add(PERF_CNT_SNAPSHOTS, 1);
+   PERF_TimerStop(PERF_TIMER_SNAPSHOT, snapStart);
    return res;
 }
 
+/**
+ * @brief Write a full iovec batch to a socket, handling partial writes
+ */
+static esp_err_t stream_writev(int fd, struct iovec *iov, int iovcnt) {
+   while (iovcnt > 0) {
+      ssize_t written = writev(fd, iov, iovcnt);
+      if (written < 0) {
+         return ESP_FAIL;
+      }
+      while ((iovcnt > 0) && (written >= (ssize_t)iov[0].iov_len)) {
+         written -= iov[0].iov_len;
+         iov++;
+         iovcnt--;
+      }
+      if (written > 0) {
+         iov[0].iov_base = (uint8_t *)iov[0].iov_base + written;
+         iov[0].iov_len -= written;
+      }
+   }
+   return ESP_OK;
+}
+
+/**
+ * @brief Task: Send stream frames to one client until the connection drops
+ *
+ * Runs detached from the httpd worker pool, one instance per stream client.
+ * When the link cannot keep up with the capture rate, the session drops
+ * frames proportionally to how far the last send overran the frame
+ * interval - a slow viewer only degrades its own feed.
+ */
+static void task_stream_tx(void *pvParameters) {
+   stream_session_t *session = (stream_session_t *)pvParameters;
+   char part_buf[64];
+   int64_t lastFrame = 0;     // Arrival time of the previous frame
+   int64_t intervalUs = 0;    // EWMA of the frame interval
+   uint8_t skipBudget = 0;    // Frames to drop before sending again
+
+   // Response header is sent raw, chunked encoding stays off for the whole stream
+   if (ESP_OK == httpd_send(session->req, _STREAM_RESPONSE, strlen(_STREAM_RESPONSE))) {
+      while (true) {
+         BC_Frame *frame = BC_WaitFrame(session->client, pdMS_TO_TICKS(1000));
+         if (NULL == frame) {
+            // Capture stalled, keep the connection and retry
+            continue;
+         }
+
+         // Track the capture rate as seen by this session
+         const int64_t now = esp_timer_get_time();
+         if (0 != lastFrame) {
+            const int64_t gap = now - lastFrame;
+            intervalUs = (0 == intervalUs) ? gap : ((7 * intervalUs + gap) / 8);
+         }
+         lastFrame = now;
+
+         if (skipBudget > 0) {
+            skipBudget--;
+            PERF_Add(PERF_CNT_FRAMES_DROPPED, 1);
+            BC_ReleaseFrame(frame);
+            continue;
+         }
+
+         struct iovec iov[3] = {
+             {.iov_base = (void *)_STREAM_BOUNDARY, .iov_len = strlen(_STREAM_BOUNDARY)},
+             {.iov_base = part_buf, .iov_len = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, frame->fb->len)},
+             {.iov_base = frame->fb->buf, .iov_len = frame->fb->len},
+         };
+         const int64_t sendStart = PERF_TimerStart();
+         esp_err_t res = stream_writev(session->fd, iov, 3);
+         PERF_TimerStop(PERF_TIMER_STREAM_SEND, sendStart);
+         PERF_Add(PERF_CNT_STREAM_FRAMES, 1);
+         PERF_Add(PERF_CNT_STREAM_BYTES, frame->fb->len);
+         BC_ReleaseFrame(frame);
+         if (res != ESP_OK) {
+            break;
+         }
+
+         // Backpressure: when the send overran the frame interval, skip
+         // as many frames as the overrun covers and recover gradually
+         const int64_t sendUs = esp_timer_get_time() - sendStart;
+         if ((intervalUs > 0) && (sendUs > intervalUs)) {
+            int64_t skip = (sendUs / intervalUs) - 1;
+            if (skip > STREAM_MAX_SKIP) {
+               skip = STREAM_MAX_SKIP;
+            }
+            skipBudget = (uint8_t)skip;
+         }
+      }
+   }
+
+   BC_Unregister(session->client);
+   httpd_req_async_handler_complete(session->req);
+   free(session);
+   vTaskDelete(NULL);
+}
+
 /**
  * @brief HTTP Request: Handle a JPG Stream
+ *
+ * Hands the connection over to a dedicated sender task via the async
+ * handler API and returns immediately, so httpd workers stay free for
+ * /snapshot and other endpoints. Frames go out on the raw socket:
+ * boundary, part header and JPEG body in a single writev per frame.
  */
 static esp_err_t stream_handler(httpd_req_t *req) {
-   camera_fb_t *fb = NULL;
-   esp_err_t res = ESP_OK;
-   size_t _jpg_buf_len;
-   uint8_t *_jpg_buf;
-   char *part_buf[64];
+   if (!CAM_WaitReady(pdMS_TO_TICKS(5000))) {
+      httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Camera not ready");
+      return ESP_FAIL;
+   }
 
-   res = httpd_resp_set_type(req, _STREAM_CONTENT_TYPE);
-   if (res != ESP_OK) {
-      return res;
+   const int fd = httpd_req_to_sockfd(req);
+   if (fd < 0) {
+      return ESP_FAIL;
    }
 
+   // Frames are large single writes, disable Nagle to avoid delayed tails
+   const int nodelay = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+   stream_session_t *session = calloc(1, sizeof(stream_session_t));
+   if (NULL == session) {
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+   }
+   session->fd = fd;
+
+   session->client = BC_Register(0);
+   if (NULL == session->client) {
+      ESP_LOGE(TAG, "STREAM: Too many clients");
+      free(session);
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+   }
+
+   if (ESP_OK != httpd_req_async_handler_begin(req, &session->req)) {
+      BC_Unregister(session->client);
+      free(session);
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+   }
+
+   if (pdPASS !=
+       xTaskCreatePinnedToCore(task_stream_tx, "Stream TX", 4096, session, TASK_PRIO_STREAM, NULL,
+                               TASK_CORE_CAPTURE)) {
+      ESP_LOGE(TAG, "STREAM: Failed to create sender task");
+      BC_Unregister(session->client);
+      httpd_req_async_handler_complete(session->req);
+      free(session);
+      return ESP_FAIL;
+   }
+
+   return ESP_OK;
+}
+
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+/**
+ * @brief Task: Send binary WebSocket frames to one client
+ *
+ * Each JPEG goes out as a single binary WS frame prefixed with a
+ * sequence/timestamp header, so the client can measure per-frame
+ * latency and detect drops without parsing multipart boundaries.
+ */
+static void task_ws_tx(void *pvParameters) {
+   stream_session_t *session = (stream_session_t *)pvParameters;
+   uint32_t seq = 0;
+
    while (true) {
-      fb = esp_camera_fb_get();
-      if (!fb) {
-         ESP_LOGE(TAG, "STREAM: Camera capture failed");
-         res = ESP_FAIL;
+      BC_Frame *frame = BC_WaitFrame(session->client, pdMS_TO_TICKS(1000));
+      if (NULL == frame) {
+         continue;
+      }
+
+      // Header + JPEG contiguous; pooled so steady-state streaming does
+      // not allocate per frame
+      const size_t need = sizeof(ws_frame_hdr_t) + frame->fb->len;
+      uint8_t *staging = BufPool_Acquire(need);
+      if (NULL == staging) {
+         BC_ReleaseFrame(frame);
          break;
       }
-      if (fb->format != PIXFORMAT_JPEG) {
-         bool jpeg_converted = frame2jpg(fb, 80, &_jpg_buf, &_jpg_buf_len);
-         if (!jpeg_converted) {
-            ESP_LOGE(TAG, "STREAM: JPEG compression failed");
-            esp_camera_fb_return(fb);
-            res = ESP_FAIL;
+
+      const ws_frame_hdr_t hdr = {.seq = seq++, .timestamp = esp_timer_get_time()};
+      memcpy(staging, &hdr, sizeof(hdr));
+      memcpy(staging + sizeof(hdr), frame->fb->buf, frame->fb->len);
+
+      httpd_ws_frame_t wsFrame = {
+          .final = true,
+          .type = HTTPD_WS_TYPE_BINARY,
+          .payload = staging,
+          .len = need,
+      };
+      const int64_t sendStart = PERF_TimerStart();
+      esp_err_t res = httpd_ws_send_frame(session->req, &wsFrame);
+      PERF_TimerStop(PERF_TIMER_STREAM_SEND, sendStart);
+      PERF_Add(PERF_CNT_STREAM_FRAMES, 1);
+      PERF_Add(PERF_CNT_STREAM_BYTES, frame->fb->len);
+      BufPool_Release(staging);
+      BC_ReleaseFrame(frame);
+      if (res != ESP_OK) {
+         break;
+      }
+   }
+
+   BC_Unregister(session->client);
+   httpd_req_async_handler_complete(session->req);
+   free(session);
+   vTaskDelete(NULL);
+}
+
+/**
+ * @brief HTTP Request: WebSocket live view
+ *
+ * The first call is the completed handshake; it hands the connection to
+ * a dedicated sender task like /stream does. Later calls deliver
+ * incoming frames (close, client chatter), which are read and ignored.
+ */
+static esp_err_t ws_handler(httpd_req_t *req) {
+   if (req->method != HTTP_GET) {
+      // Drain the incoming frame including its payload (ping payloads,
+      // close reasons): leftover bytes would be parsed as the next frame
+      // header and desync the socket. The sender notices a closed socket
+      // itself. Control frames fit the static buffer, larger client
+      // chatter falls back to the heap
+      static uint8_t wsDrain[128];
+      httpd_ws_frame_t wsFrame = {0};
+      esp_err_t res = httpd_ws_recv_frame(req, &wsFrame, 0);
+      if ((ESP_OK == res) && (wsFrame.len > 0)) {
+         uint8_t *buf = (wsFrame.len <= sizeof(wsDrain)) ? wsDrain : malloc(wsFrame.len);
+         if (NULL == buf) {
+            return ESP_ERR_NO_MEM;
+         }
+         wsFrame.payload = buf;
+         res = httpd_ws_recv_frame(req, &wsFrame, wsFrame.len);
+         if (buf != wsDrain) {
+            free(buf);
          }
-      } else {
-         _jpg_buf_len = fb->len;
-         _jpg_buf = fb->buf;
       }
+      return res;
+   }
 
-      if (res == ESP_OK) {
-         res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
+   if (!CAM_WaitReady(pdMS_TO_TICKS(5000))) {
+      return ESP_FAIL;
+   }
+
+   stream_session_t *session = calloc(1, sizeof(stream_session_t));
+   if (NULL == session) {
+      return ESP_FAIL;
+   }
+
+   session->client = BC_Register(0);
+   if (NULL == session->client) {
+      ESP_LOGE(TAG, "WS: Too many clients");
+      free(session);
+      return ESP_FAIL;
+   }
+
+   if (ESP_OK != httpd_req_async_handler_begin(req, &session->req)) {
+      BC_Unregister(session->client);
+      free(session);
+      return ESP_FAIL;
+   }
+
+   if (pdPASS !=
+       xTaskCreatePinnedToCore(task_ws_tx, "WS TX", 4096, session, TASK_PRIO_STREAM, NULL, TASK_CORE_CAPTURE)) {
+      ESP_LOGE(TAG, "WS: Failed to create sender task");
+      BC_Unregister(session->client);
+      httpd_req_async_handler_complete(session->req);
+      free(session);
+      return ESP_FAIL;
+   }
+
+   return ESP_OK;
+}
+#endif   // CONFIG_HTTPD_WS_SUPPORT
+
+/**
+ * @brief HTTP Request: Get or switch the camera profile
+ *
+ * GET /profile returns the active profile, GET /profile?name=<profile>
+ * switches to it.
+ */
+static esp_err_t profile_handler(httpd_req_t *req) {
+   char query[64];
+   char name[32];
+
+   if (ESP_OK == httpd_req_get_url_query_str(req, query, sizeof(query))) {
+      if (ESP_OK == httpd_query_key_value(query, "name", name, sizeof(name))) {
+         if (ESP_OK != CAM_ApplyProfileByName(name)) {
+            httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Unknown profile");
+            return ESP_FAIL;
+         }
       }
-      if (res == ESP_OK) {
-         size_t hlen = snprintf((char *)part_buf, 64, _STREAM_PART, _jpg_buf_len);
+   }
 
-         res = httpd_resp_send_chunk(req, (const char *)part_buf, hlen);
+   httpd_resp_set_type(req, "text/plain");
+   return httpd_resp_send(req, CAM_GetProfileName(CAM_GetProfile()), HTTPD_RESP_USE_STRLEN);
+}
+
+/**
+ * @brief HTTP Request: Set or clear the sensor readout window
+ *
+ * GET /window?x=&y=&w=&h= restricts the readout to the region of
+ * interest for high-FPS cropped streaming, GET /window without
+ * parameters restores the full frame.
+ */
+static esp_err_t window_handler(httpd_req_t *req) {
+   char query[96];
+   char value[8];
+   long x = 0, y = 0, w = 0, h = 0;
+   bool haveWindow = false;
+
+   if (ESP_OK == httpd_req_get_url_query_str(req, query, sizeof(query))) {
+      haveWindow = (ESP_OK == httpd_query_key_value(query, "x", value, sizeof(value))) && ((x = atol(value)) >= 0);
+      haveWindow = haveWindow && (ESP_OK == httpd_query_key_value(query, "y", value, sizeof(value))) &&
+                   ((y = atol(value)) >= 0);
+      haveWindow = haveWindow && (ESP_OK == httpd_query_key_value(query, "w", value, sizeof(value))) &&
+                   ((w = atol(value)) > 0);
+      haveWindow = haveWindow && (ESP_OK == httpd_query_key_value(query, "h", value, sizeof(value))) &&
+                   ((h = atol(value)) > 0);
+   }
+
+   esp_err_t res = haveWindow ? CAM_SetWindow(x, y, w, h) : CAM_ClearWindow();
+   if (ESP_ERR_NOT_SUPPORTED == res) {
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Sensor has no windowing support");
+      return ESP_FAIL;
+   }
+   if (ESP_OK != res) {
+      httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid window");
+      return ESP_FAIL;
+   }
+
+   httpd_resp_set_type(req, "text/plain");
+   return httpd_resp_send(req, haveWindow ? "window set" : "window cleared", HTTPD_RESP_USE_STRLEN);
+}
+
+#ifdef CONFIG_ARCHIVE_ENABLE
+/**
+ * @brief HTTP Request: Retrieve archived frames
+ *
+ * GET /history?since=<seconds> streams the frames of the last N seconds
+ * (default 10) as a multipart response, oldest first.
+ */
+static esp_err_t history_handler(httpd_req_t *req) {
+   char query[64];
+   char value[16];
+   char part_buf[64];
+   long seconds = 10;
+
+   if (ESP_OK == httpd_req_get_url_query_str(req, query, sizeof(query))) {
+      if (ESP_OK == httpd_query_key_value(query, "since", value, sizeof(value))) {
+         seconds = atol(value);
       }
+   }
+
+   esp_err_t res = httpd_resp_set_type(req, "multipart/mixed;boundary=" PART_BOUNDARY);
+   if (res != ESP_OK) {
+      return res;
+   }
+
+   int64_t timestamp = esp_timer_get_time() - ((int64_t)seconds * 1000000);
+   while (res == ESP_OK) {
+      uint8_t *buf = NULL;
+      size_t len = 0;
+      if (ESP_OK != Archive_GetNext(&timestamp, &buf, &len)) {
+         break;
+      }
+
+      res = httpd_resp_send_chunk(req, _STREAM_BOUNDARY, strlen(_STREAM_BOUNDARY));
       if (res == ESP_OK) {
-         res = httpd_resp_send_chunk(req, (const char *)_jpg_buf, _jpg_buf_len);
+         size_t hlen = snprintf(part_buf, sizeof(part_buf), _STREAM_PART, len);
+         res = httpd_resp_send_chunk(req, part_buf, hlen);
       }
-      if (fb->format != PIXFORMAT_JPEG) {
-         free(_jpg_buf);
+      if (res == ESP_OK) {
+         res = httpd_resp_send_chunk(req, (const char *)buf, len);
       }
-      esp_camera_fb_return(fb);
-      if (res != ESP_OK) {
+      free(buf);
+   }
+
+   httpd_resp_send_chunk(req, NULL, 0);
+   return res;
+}
+#endif   // CONFIG_ARCHIVE_ENABLE
+
+#ifdef CONFIG_TIMELAPSE_ENABLE
+/**
+ * @brief HTTP Request: Download a time-lapse segment
+ *
+ * GET /archive?seg=<n> streams the raw segment file (length-prefixed
+ * JPEG records) in one TCP transfer; without a parameter the current
+ * segment is sent. Pulling whole segments instead of per-frame requests
+ * keeps the radio duty cycle low on battery deployments.
+ */
+static esp_err_t archive_handler(httpd_req_t *req) {
+   char query[32];
+   char value[16];
+   char path[48];
+   static char chunk[4096];
+   uint32_t segment = Timelapse_GetCurrentSegment();
+
+   if (ESP_OK == httpd_req_get_url_query_str(req, query, sizeof(query))) {
+      if (ESP_OK == httpd_query_key_value(query, "seg", value, sizeof(value))) {
+         segment = (uint32_t)atol(value);
+      }
+   }
+
+   Timelapse_GetSegmentPath(segment, path, sizeof(path));
+   FILE *f = fopen(path, "rb");
+   if (NULL == f) {
+      httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No such segment");
+      return ESP_FAIL;
+   }
+
+   esp_err_t res = httpd_resp_set_type(req, "application/octet-stream");
+   if (res == ESP_OK) {
+      res = httpd_resp_set_hdr(req, "Content-Disposition", "attachment");
+   }
+
+   while (res == ESP_OK) {
+      const size_t len = fread(chunk, 1, sizeof(chunk), f);
+      if (0 == len) {
          break;
       }
+      res = httpd_resp_send_chunk(req, chunk, len);
    }
+   fclose(f);
 
+   httpd_resp_send_chunk(req, NULL, 0);
    return res;
 }
+#endif   // CONFIG_TIMELAPSE_ENABLE
+
+#ifdef CONFIG_BENCH_ENABLE
+/**
+ * @brief HTTP Request: Run the on-device benchmark
+ *
+ * GET /bench?n=<iterations> captures N frames with per-stage timing and
+ * returns the JSON report. Blocks this httpd worker for the duration;
+ * run without active stream clients for comparable numbers.
+ */
+static esp_err_t bench_handler(httpd_req_t *req) {
+   static char benchBuffer[BENCH_RESULT_SIZE];
+   char query[32];
+   char value[8];
+   long iterations = 32;
+
+   if (ESP_OK == httpd_req_get_url_query_str(req, query, sizeof(query))) {
+      if (ESP_OK == httpd_query_key_value(query, "n", value, sizeof(value))) {
+         iterations = atol(value);
+      }
+   }
+
+   if (ESP_OK != Bench_Run((uint32_t)iterations, benchBuffer, sizeof(benchBuffer))) {
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+   }
+
+   httpd_resp_set_type(req, "application/json");
+   return httpd_resp_send(req, benchBuffer, HTTPD_RESP_USE_STRLEN);
+}
+#endif   // CONFIG_BENCH_ENABLE
+
+/**
+ * @brief HTTP Request: Export performance counters in Prometheus format
+ */
+static esp_err_t metrics_handler(httpd_req_t *req) {
+   static char metricsBuffer[2048];
+
+   const size_t len = PERF_Export(metricsBuffer, sizeof(metricsBuffer));
+   if (0 == len) {
+      httpd_resp_send_500(req);
+      return ESP_FAIL;
+   }
+   httpd_resp_set_type(req, "text/plain; version=0.0.4");
+   return httpd_resp_send(req, metricsBuffer, len);
+}
 
 /**
  * @brief Start the webserver and register URIs
@@ -226,13 +828,39 @@ static httpd_handle_t start_webserver(void) {
    httpd_handle_t server = NULL;
    httpd_config_t config = HTTPD_DEFAULT_CONFIG();
 
+#if CONFIG_SNAPSHOT_CACHE_TTL > 0
+   snapCache.lock = xSemaphoreCreateMutex();
+   if (NULL == snapCache.lock) {
+      ESP_LOGE(TAG, "Failed to create snapshot cache lock!");
+      return NULL;
+   }
+#endif
+
    config.lru_purge_enable = true;
+   config.max_uri_handlers = 12;   // The default of 8 is too small with all features on
+   config.core_id = TASK_CORE_CAPTURE;
+   config.task_priority = TASK_PRIO_STREAM;
 
    ESP_LOGI(TAG, "Starting server on port: '%d'", config.server_port);
    if (httpd_start(&server, &config) == ESP_OK) {
       // Set URI handlers
       httpd_register_uri_handler(server, &uri_snapshot);
       httpd_register_uri_handler(server, &uri_stream);
+#ifdef CONFIG_HTTPD_WS_SUPPORT
+      httpd_register_uri_handler(server, &uri_ws);
+#endif
+      httpd_register_uri_handler(server, &uri_profile);
+      httpd_register_uri_handler(server, &uri_window);
+#ifdef CONFIG_ARCHIVE_ENABLE
+      httpd_register_uri_handler(server, &uri_history);
+#endif
+#ifdef CONFIG_TIMELAPSE_ENABLE
+      httpd_register_uri_handler(server, &uri_archive);
+#endif
+#ifdef CONFIG_BENCH_ENABLE
+      httpd_register_uri_handler(server, &uri_bench);
+#endif
+      httpd_register_uri_handler(server, &uri_metrics);
 
       return server;
    }
@@ -243,48 +871,152 @@ static httpd_handle_t start_webserver(void) {
 
 /**
  * @brief Task: Send cyclic MQTT statistics
+ *
+ * Encodes into a preallocated buffer so the 30 s cycle does not churn
+ * the heap the camera driver allocates frame buffers from.
  */
 static void task_mqtt_stats(void *pvParameters) {
+   static char statsBuffer[STATS_BUFFER_SIZE];
+   uint32_t lastFrameCount = 0;
+
    while (1) {
-      vTaskDelay(pdMS_TO_TICKS(TIME_MQTT_STATS));
-
-      cJSON *jsonMsg = cJSON_CreateObject();
-      if (NULL != jsonMsg) {
-         char *string = NULL;
-         time_t now;
-         time(&now);
-         cJSON_AddNumberToObject(jsonMsg, "Uptime", (xTaskGetTickCount() * configTICK_RATE_HZ) / 10000);
-         cJSON_AddNumberToObject(jsonMsg, "Timestamp", now);
-         cJSON_AddStringToObject(jsonMsg, "Firmware", __TIME__ " " __DATE__);
-
-         string = cJSON_Print(jsonMsg);
-         MQTT_Transmit("Status", string, 0);
-
-         if (NULL != jsonMsg) {
-            cJSON_Delete(jsonMsg);
-         }
-         if (NULL != string) {
-            free(string);
-         }
+      const uint32_t cycleMs = CFG_GetStatsInterval();
+      vTaskDelay(pdMS_TO_TICKS(cycleMs));
+
+      time_t now;
+      time(&now);
+
+      wifi_ap_record_t ap = {0};
+      esp_wifi_sta_get_ap_info(&ap);
+
+      // Average FPS over the stats cycle, two decimals fixed-point
+      const uint32_t frameCount = BC_GetFrameCount();
+      const uint32_t fps100 = ((frameCount - lastFrameCount) * 100 * 1000) / cycleMs;
+      lastFrameCount = frameCount;
+
+      const int len = snprintf(statsBuffer, sizeof(statsBuffer),
+                               "{\"Uptime\":%" PRIu32 ",\"Timestamp\":%lld,\"Firmware\":\"%s\","
+                               "\"FreeHeap\":%" PRIu32 ",\"MinFreeHeap\":%" PRIu32 ",\"FreePsram\":%u,"
+                               "\"RSSI\":%d,\"FPS\":%" PRIu32 ".%02" PRIu32 ",\"StreamClients\":%u}",
+                               (xTaskGetTickCount() * configTICK_RATE_HZ) / 10000, (long long)now,
+                               __TIME__ " " __DATE__, esp_get_free_heap_size(), esp_get_minimum_free_heap_size(),
+                               (unsigned)heap_caps_get_free_size(MALLOC_CAP_SPIRAM), ap.rssi, fps100 / 100,
+                               fps100 % 100, BC_GetClientCount());
+      if ((len > 0) && (len < (int)sizeof(statsBuffer))) {
+         MQTT_Publish(topicStatus, statsBuffer, len);
+      } else {
+         ESP_LOGW(TAG, "Stats message truncated!");
       }
    }
 }
 
+/**
+ * @brief Publish a frame to MQTT, transcoded to the configured snapshot size
+ */
+static void mqtt_publish_frame(const camera_fb_t *fb) {
+   if (fb->format != PIXFORMAT_JPEG) {
+      ESP_LOGW(TAG, "Framebuffer format 0x%02x not supported!", fb->format);
+      return;
+   }
+
+#if CONFIG_CAM_MQTT_IMAGE_SCALE > 0
+   uint8_t *jpg = NULL;
+   size_t jpg_len = 0;
+   if (ESP_OK == Transcode_JpegScale(fb, (jpg_scale_t)CONFIG_CAM_MQTT_IMAGE_SCALE, CONFIG_CAM_MQTT_IMAGE_QUALITY, &jpg,
+                                     &jpg_len)) {
+      MQTT_PublishLarge(topicSnapshot, (const char *)jpg, jpg_len);
+      free(jpg);
+   } else {
+      // Fall back to the full frame rather than dropping the publish
+      MQTT_PublishLarge(topicSnapshot, (const char *)fb->buf, fb->len);
+   }
+#else
+   MQTT_PublishLarge(topicSnapshot, (const char *)fb->buf, fb->len);
+#endif
+}
+
 // Task: Send MQTT Image
 static void task_mqtt_image(void *pvParameters) {
+   CAM_WaitReady(portMAX_DELAY);
+#ifdef CONFIG_CAM_MOTION_ENABLE
+   int64_t lastPublish = 0;
+
    while (1) {
-      vTaskDelay(pdMS_TO_TICKS(TIME_MQTT_IMAGE));
+      vTaskDelay(pdMS_TO_TICKS(CONFIG_CAM_MOTION_INTERVAL));
+
+      PM_AcquireCapture();
+      camera_fb_t *fb = esp_camera_fb_get();
+      if (NULL == fb) {
+         PM_ReleaseCapture();
+         continue;
+      }
+
+      // Publish on motion, or as heartbeat after the regular cycle time
+      const bool motion = Motion_Detect(fb);
+      const int64_t now = esp_timer_get_time();
+      if (motion || ((now - lastPublish) >= ((int64_t)CFG_GetImageInterval() * 1000))) {
+         mqtt_publish_frame(fb);
+         lastPublish = now;
+      }
+      esp_camera_fb_return(fb);
+      PM_ReleaseCapture();
+   }
+#else
+   while (1) {
+      vTaskDelay(pdMS_TO_TICKS(CFG_GetImageInterval()));
 
       // TX a JPG to MQTT
+      PM_AcquireCapture();
       camera_fb_t *fb = esp_camera_fb_get();
       if (fb) {
-         if (fb->format == PIXFORMAT_JPEG) {
-            MQTT_Transmit("Snapshot", (const char *)fb->buf, fb->len);
-         } else {
-            ESP_LOGW(TAG, "Framebuffer format 0x%02x not supported!", fb->format);
-         }
+         mqtt_publish_frame(fb);
          esp_camera_fb_return(fb);
       }
+      PM_ReleaseCapture();
+   }
+#endif
+}
+
+/**
+ * @brief Command: Switch the camera profile by name in the payload
+ */
+static void cmd_profile(const char *SubTopic, const char *Payload, int PayloadLength) {
+   if (ESP_OK != CAM_ApplyProfileByName(Payload)) {
+      ESP_LOGW(TAG, "CMD: Unknown profile '%s'", Payload);
+   }
+}
+
+/**
+ * @brief Command: Publish a snapshot on demand
+ */
+static void cmd_capture(const char *SubTopic, const char *Payload, int PayloadLength) {
+   PM_AcquireCapture();
+   camera_fb_t *fb = esp_camera_fb_get();
+   if (NULL != fb) {
+      mqtt_publish_frame(fb);
+      esp_camera_fb_return(fb);
+   } else {
+      ESP_LOGW(TAG, "CMD: Capture failed");
+   }
+   PM_ReleaseCapture();
+}
+
+/**
+ * @brief Command: Update a runtime setting, payload is "key=value"
+ */
+static void cmd_config(const char *SubTopic, const char *Payload, int PayloadLength) {
+   char key[CFG_MAX_STRLEN];
+
+   const char *sep = strchr(Payload, '=');
+   if ((NULL == sep) || (sep == Payload) || ((size_t)(sep - Payload) >= sizeof(key))) {
+      ESP_LOGW(TAG, "CMD: Malformed config '%s'", Payload);
+      return;
+   }
+   memcpy(&key[0], Payload, sep - Payload);
+   key[sep - Payload] = '\0';
+
+   if (ESP_OK != CFG_Set(key, sep + 1)) {
+      ESP_LOGW(TAG, "CMD: Rejected config '%s'", Payload);
    }
 }
 
@@ -351,20 +1083,55 @@ void app_main(void) {
   }
 #endif
 
+   // Load all settings into RAM once; WiFi/MQTT and the cyclic tasks read
+   // the cached copy instead of hitting NVS themselves
+   ESP_ERROR_CHECK(CFG_Init());
+
+   // Sensor probe and DMA setup run concurrently with network bring-up,
+   // a local HTTP client gets its first frame without waiting for WiFi
+   ESP_ERROR_CHECK(PM_Init());
+   ESP_ERROR_CHECK(CAM_InitAsync());
+   ESP_ERROR_CHECK(BufPool_Init());
+   ESP_ERROR_CHECK(BC_Init());
+#ifdef CONFIG_ARCHIVE_ENABLE
+   ESP_ERROR_CHECK(Archive_Init());
+#endif
+#ifdef CONFIG_TIMELAPSE_ENABLE
+   if (ESP_OK != Timelapse_Init()) {
+      ESP_LOGE(TAG, "Time-lapse recording unavailable");
+   }
+#endif
+
    if (ESP_OK == WiFi_Init()) {
+      // Association runs in the background with lifetime reconnect; wait a
+      // bounded time for the first connection, MQTT recovers on its own if
+      // the network shows up later
+      if (ESP_OK != WiFi_WaitConnected(pdMS_TO_TICKS(30000))) {
+         ESP_LOGW(TAG, "WiFi not connected yet, continuing startup");
+      }
       MQTT_Init();
+      // Lossy delivery is fine for images, QoS 0 keeps them out of the outbox
+      topicStatus = MQTT_RegisterTopic("Status", 1, false);
+      topicSnapshot = MQTT_RegisterTopic("Snapshot", 0, false);
+      // Inbound commands: handlers run in the dispatcher task, not the
+      // MQTT event callback
+      ESP_ERROR_CHECK(CMD_Init());
+      CMD_Register("cmd/profile", cmd_profile);
+      CMD_Register("cmd/capture", cmd_capture);
+      CMD_Register("cmd/config", cmd_config);
       start_webserver();
+#ifdef CONFIG_UDPCAST_ENABLE
+      ESP_ERROR_CHECK(UDPCast_Init());
+#endif
    } else {
       // TODO: If WiFi init failed, re-init in AP mode
    }
 
-   ESP_ERROR_CHECK(esp_camera_init(&camera_config));
-
    ESP_LOGI(TAG, "Entering loop");
 
-   // Start the tasks
-   xTaskCreate(task_mqtt_image, "MQTT Image", 4096, NULL, tskIDLE_PRIORITY, NULL);
-   xTaskCreate(task_mqtt_stats, "MQTT Stats", 4096, NULL, tskIDLE_PRIORITY, NULL);
+   // Start the tasks on the comms core, below the capture path
+   xTaskCreatePinnedToCore(task_mqtt_image, "MQTT Image", 4096, NULL, TASK_PRIO_MQTT, NULL, TASK_CORE_COMMS);
+   xTaskCreatePinnedToCore(task_mqtt_stats, "MQTT Stats", 4096, NULL, TASK_PRIO_MQTT, NULL, TASK_CORE_COMMS);
 
    while (1) {
       vTaskDelay(pdMS_TO_TICKS(10000));
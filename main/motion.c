@@ -0,0 +1,168 @@
+/**
+ ******************************************************************************
+ *  file           : motion.c
+ *  brief          : Frame-difference motion detection
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "motion.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+#include "esp_heap_caps.h"
+#include "esp_jpg_decode.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_CAM_MOTION_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   const uint8_t *jpg;   // JPEG input for the decode reader
+   size_t jpg_len;
+   uint8_t *gray;   // Grayscale output plane
+   uint16_t width;
+   uint16_t height;
+} decode_ctx_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define MOTION_BLOCK_SIZE 16   // Edge length of a SAD block in downscaled pixels
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "MOTION";
+
+static uint8_t *grayCur = NULL;    // Current downscaled grayscale frame
+static uint8_t *grayPrev = NULL;   // Previous downscaled grayscale frame
+static uint16_t grayWidth = 0;
+static uint16_t grayHeight = 0;
+static bool havePrev = false;
+
+/* Private function prototypes -----------------------------------------------*/
+
+static size_t jpg_read_cb(void *arg, size_t index, uint8_t *buf, size_t len);
+static bool jpg_write_cb(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Reader for esp_jpg_decode, feeds from the framebuffer
+ */
+static size_t jpg_read_cb(void *arg, size_t index, uint8_t *buf, size_t len) {
+   decode_ctx_t *ctx = (decode_ctx_t *)arg;
+   if (index + len > ctx->jpg_len) {
+      len = ctx->jpg_len - index;
+   }
+   if (NULL != buf) {
+      memcpy(buf, ctx->jpg + index, len);
+   }
+   return len;
+}
+
+/**
+ * @brief Writer for esp_jpg_decode, converts RGB888 blocks to grayscale
+ */
+static bool jpg_write_cb(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data) {
+   decode_ctx_t *ctx = (decode_ctx_t *)arg;
+   if (NULL == data) {
+      return true;   // Start/end marker
+   }
+   for (uint16_t row = 0; row < h; row++) {
+      if ((y + row) >= ctx->height) {
+         break;
+      }
+      uint8_t *dst = ctx->gray + (y + row) * ctx->width + x;
+      const uint8_t *src = data + row * w * 3;
+      for (uint16_t col = 0; (col < w) && ((x + col) < ctx->width); col++) {
+         // Cheap luma: (R + 2G + B) / 4
+         dst[col] = (uint8_t)((src[3 * col] + 2 * src[3 * col + 1] + src[3 * col + 2]) >> 2);
+      }
+   }
+   return true;
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+bool Motion_Detect(const camera_fb_t *fb) {
+   if ((NULL == fb) || (fb->format != PIXFORMAT_JPEG)) {
+      return false;
+   }
+
+   const uint16_t width = fb->width / 8;
+   const uint16_t height = fb->height / 8;
+
+   // (Re)allocate the grayscale planes in internal RAM so the SAD loop
+   // never touches PSRAM
+   if ((NULL == grayCur) || (width != grayWidth) || (height != grayHeight)) {
+      free(grayCur);
+      free(grayPrev);
+      grayCur = heap_caps_malloc(width * height, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+      grayPrev = heap_caps_malloc(width * height, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+      if ((NULL == grayCur) || (NULL == grayPrev)) {
+         ESP_LOGE(TAG, "Failed to allocate %u bytes for grayscale planes", 2 * width * height);
+         free(grayCur);
+         free(grayPrev);
+         grayCur = NULL;
+         grayPrev = NULL;
+         return false;
+      }
+      grayWidth = width;
+      grayHeight = height;
+      havePrev = false;
+   }
+
+   decode_ctx_t ctx = {
+       .jpg = fb->buf,
+       .jpg_len = fb->len,
+       .gray = grayCur,
+       .width = width,
+       .height = height,
+   };
+   if (ESP_OK != esp_jpg_decode(fb->len, JPG_SCALE_8X, jpg_read_cb, jpg_write_cb, &ctx)) {
+      ESP_LOGE(TAG, "JPEG decode failed");
+      return false;
+   }
+
+   bool motion = false;
+   if (havePrev) {
+      // Blocked SAD: count blocks whose mean pixel difference crosses the
+      // threshold, fixed-point throughout
+      uint16_t changedBlocks = 0;
+      for (uint16_t by = 0; by + MOTION_BLOCK_SIZE <= height; by += MOTION_BLOCK_SIZE) {
+         for (uint16_t bx = 0; bx + MOTION_BLOCK_SIZE <= width; bx += MOTION_BLOCK_SIZE) {
+            uint32_t sad = 0;
+            for (uint16_t row = 0; row < MOTION_BLOCK_SIZE; row++) {
+               const uint8_t *cur = grayCur + (by + row) * width + bx;
+               const uint8_t *prev = grayPrev + (by + row) * width + bx;
+               for (uint16_t col = 0; col < MOTION_BLOCK_SIZE; col++) {
+                  sad += (cur[col] > prev[col]) ? (cur[col] - prev[col]) : (prev[col] - cur[col]);
+               }
+            }
+            if ((sad / (MOTION_BLOCK_SIZE * MOTION_BLOCK_SIZE)) > CONFIG_CAM_MOTION_PIXEL_THRESHOLD) {
+               changedBlocks++;
+            }
+         }
+      }
+      motion = (changedBlocks >= CONFIG_CAM_MOTION_BLOCK_COUNT);
+      if (motion) {
+         ESP_LOGI(TAG, "Motion: %u blocks changed", changedBlocks);
+      }
+   }
+
+   // Swap planes, current becomes the reference
+   uint8_t *tmp = grayPrev;
+   grayPrev = grayCur;
+   grayCur = tmp;
+   havePrev = true;
+
+   return motion;
+}
+
+#endif   // CONFIG_CAM_MOTION_ENABLE
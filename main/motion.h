@@ -0,0 +1,48 @@
+/**
+ ******************************************************************************
+ *  file           : motion.h
+ *  brief          : Frame-difference motion detection
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef MOTION_H_
+#define MOTION_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <esp_camera.h>
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Check a frame for motion against the previously seen frame
+ *
+ * Decodes the JPEG at 1/8 scale to grayscale and runs a blocked
+ * sum-of-absolute-differences against the previous downscaled frame.
+ * The first call after boot never reports motion.
+ *
+ * @param fb The captured frame (JPEG)
+ * @return true if enough blocks changed, false otherwise
+ */
+bool Motion_Detect(const camera_fb_t *fb);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // MOTION_H_
@@ -0,0 +1,86 @@
+/**
+ ******************************************************************************
+ *  file           : pmlock.c
+ *  brief          : Power-management locks around capture activity
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "pmlock.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+#ifdef CONFIG_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+/* Private typedef -----------------------------------------------------------*/
+
+/* Private define ------------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+#ifdef CONFIG_PM_ENABLE
+
+static const char *TAG = "PMLOCK";
+
+static esp_pm_lock_handle_t lockCpu = NULL;     // Max CPU frequency
+static esp_pm_lock_handle_t lockSleep = NULL;   // No light sleep
+
+#endif
+
+/* Private function prototypes -----------------------------------------------*/
+
+/* Private user code ---------------------------------------------------------*/
+
+/* Public user code ----------------------------------------------------------*/
+
+#ifdef CONFIG_PM_ENABLE
+
+esp_err_t PM_Init(void) {
+   esp_err_t res = esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cam_cpu", &lockCpu);
+   if (ESP_OK == res) {
+      res = esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "cam_nosleep", &lockSleep);
+   }
+   if (ESP_OK != res) {
+      ESP_LOGE(TAG, "Failed to create locks: %s", esp_err_to_name(res));
+      return res;
+   }
+   ESP_LOGI(TAG, "Capture locks created");
+   return ESP_OK;
+}
+
+void PM_AcquireCapture(void) {
+   // esp_pm locks are reference counted, overlapping callers just stack
+   if (NULL != lockCpu) {
+      esp_pm_lock_acquire(lockCpu);
+   }
+   if (NULL != lockSleep) {
+      esp_pm_lock_acquire(lockSleep);
+   }
+}
+
+void PM_ReleaseCapture(void) {
+   if (NULL != lockSleep) {
+      esp_pm_lock_release(lockSleep);
+   }
+   if (NULL != lockCpu) {
+      esp_pm_lock_release(lockCpu);
+   }
+}
+
+#else   // CONFIG_PM_ENABLE
+
+// Without power management the clocks never scale, nothing to hold
+esp_err_t PM_Init(void) { return ESP_OK; }
+void PM_AcquireCapture(void) {}
+void PM_ReleaseCapture(void) {}
+
+#endif   // CONFIG_PM_ENABLE
@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ *  file           : pmlock.h
+ *  brief          : Power-management locks around capture activity
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef PMLOCK_H_
+#define PMLOCK_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Create the CPU-max and no-light-sleep locks
+ *
+ * All functions compile to no-ops when power management is disabled.
+ *
+ * @return esp_err_t
+ */
+esp_err_t PM_Init(void);
+
+/**
+ * @brief Hold max CPU frequency and block light sleep during a capture
+ *
+ * Reference counted by the esp_pm locks; pair every acquire with a
+ * release. Overlapping activities (stream clients, snapshots, MQTT
+ * captures) each hold their own reference.
+ */
+void PM_AcquireCapture(void);
+
+/**
+ * @brief Release the capture locks, clocks scale down when idle again
+ */
+void PM_ReleaseCapture(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // PMLOCK_H_
@@ -0,0 +1,49 @@
+/**
+ ******************************************************************************
+ *  file           : taskcfg.h
+ *  brief          : Core assignment and priorities for all firmware tasks
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef TASKCFG_H_
+#define TASKCFG_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/*
+ * Core map: frame capture and stream sending run on the app core, away
+ * from WiFi/lwIP/MQTT which ESP-IDF runs on core 0. This keeps MQTT
+ * publishes from injecting jitter into the capture path.
+ */
+#define TASK_CORE_CAPTURE 1   // Camera capture, stream senders, httpd
+#define TASK_CORE_COMMS   0   // MQTT publishing and statistics
+
+/* Priorities: the capture path outranks everything else we create */
+#define TASK_PRIO_CAPTURE (tskIDLE_PRIORITY + 5)   // Camera capture task
+#define TASK_PRIO_STREAM  (tskIDLE_PRIORITY + 4)   // Stream sender tasks, httpd
+#define TASK_PRIO_ARCHIVE (tskIDLE_PRIORITY + 2)   // Frame archive recorder
+#define TASK_PRIO_MQTT    (tskIDLE_PRIORITY + 1)   // MQTT image and stats tasks
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // TASKCFG_H_
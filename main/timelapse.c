@@ -0,0 +1,215 @@
+/**
+ ******************************************************************************
+ *  file           : timelapse.c
+ *  brief          : Time-lapse recorder writing frame segments to flash
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "timelapse.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "broadcast.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_vfs_fat.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "sdkconfig.h"
+#include "taskcfg.h"
+#include "wear_levelling.h"
+
+#ifdef CONFIG_TIMELAPSE_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+
+// On-flash record header, directly followed by the JPEG data
+typedef struct {
+   uint32_t magic;       // TIMELAPSE_MAGIC
+   uint32_t length;      // JPEG size in bytes
+   int64_t timestamp;    // Capture time in us since boot
+} __attribute__((packed)) record_hdr_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define TIMELAPSE_MAGIC 0x544C4A50   // "TLJP"
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "Timelapse";
+
+static wl_handle_t wlHandle = WL_INVALID_HANDLE;
+static uint32_t curSegment  = 0;        // Segment currently written to
+static FILE *curFile        = NULL;     // Open segment file
+static size_t curSize       = 0;        // Bytes written to the open segment
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_recorder(void *pvParameters);
+static esp_err_t segment_open(void);
+static void segment_rotate(void);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Open the current segment file for appending
+ *
+ * @return esp_err_t
+ */
+static esp_err_t segment_open(void) {
+   char path[48];
+
+   Timelapse_GetSegmentPath(curSegment, path, sizeof(path));
+   curFile = fopen(path, "ab");
+   if (NULL == curFile) {
+      ESP_LOGE(TAG, "Cannot open %s", path);
+      return ESP_FAIL;
+   }
+   fseek(curFile, 0, SEEK_END);
+   curSize = (size_t)ftell(curFile);
+   ESP_LOGI(TAG, "Recording to %s (%u bytes)", path, (unsigned)curSize);
+   return ESP_OK;
+}
+
+/**
+ * @brief Close the full segment, delete the oldest and start the next one
+ */
+static void segment_rotate(void) {
+   char path[48];
+
+   if (NULL != curFile) {
+      fclose(curFile);
+      curFile = NULL;
+   }
+   curSegment++;
+   if (curSegment >= CONFIG_TIMELAPSE_MAX_SEGMENTS) {
+      Timelapse_GetSegmentPath(curSegment - CONFIG_TIMELAPSE_MAX_SEGMENTS, path, sizeof(path));
+      if (0 == unlink(path)) {
+         ESP_LOGI(TAG, "Deleted old segment %s", path);
+      }
+   }
+}
+
+/**
+ * @brief The recorder task: appends one frame per interval to the segment
+ *
+ * @param pvParameters unused
+ */
+static void task_recorder(void *pvParameters) {
+   BC_Client *client = BC_Register(CONFIG_TIMELAPSE_INTERVAL);
+
+   if (NULL == client) {
+      ESP_LOGE(TAG, "Cannot register at the broadcaster!");
+      vTaskDelete(NULL);
+   }
+
+   while (1) {
+      vTaskDelay(pdMS_TO_TICKS(CONFIG_TIMELAPSE_INTERVAL));
+
+      BC_Frame *frame = BC_WaitFrame(client, pdMS_TO_TICKS(1000));
+      if (NULL == frame) {
+         continue;
+      }
+
+      if ((NULL == curFile) && (ESP_OK != segment_open())) {
+         BC_ReleaseFrame(frame);
+         continue;
+      }
+
+      record_hdr_t hdr = {
+          .magic     = TIMELAPSE_MAGIC,
+          .length    = frame->fb->len,
+          .timestamp = esp_timer_get_time(),
+      };
+      if ((1 != fwrite(&hdr, sizeof(hdr), 1, curFile)) ||
+          (frame->fb->len != fwrite(frame->fb->buf, 1, frame->fb->len, curFile))) {
+         ESP_LOGW(TAG, "Write failed, rotating segment");
+         segment_rotate();
+      } else {
+         fflush(curFile);
+         fsync(fileno(curFile));
+         curSize += sizeof(hdr) + frame->fb->len;
+         if (curSize >= CONFIG_TIMELAPSE_SEGMENT_KB * 1024) {
+            segment_rotate();
+         }
+      }
+      BC_ReleaseFrame(frame);
+   }
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t Timelapse_Init(void) {
+   const esp_vfs_fat_mount_config_t mountConfig = {
+       .max_files              = 2,
+       .format_if_mount_failed = true,
+       .allocation_unit_size   = CONFIG_WL_SECTOR_SIZE,
+   };
+
+   esp_err_t err = esp_vfs_fat_spiflash_mount_rw_wl(TIMELAPSE_MOUNT, "storage", &mountConfig, &wlHandle);
+   if (ESP_OK != err) {
+      ESP_LOGE(TAG, "Cannot mount storage partition: %s", esp_err_to_name(err));
+      return err;
+   }
+
+   // Resume after the newest existing segment instead of overwriting it.
+   // After the ring has wrapped the low indices are deleted, so scan the
+   // directory for the highest index rather than probing for the first gap
+   DIR *dir = opendir(TIMELAPSE_MOUNT);
+   if (NULL != dir) {
+      struct dirent *entry;
+      uint32_t minSeg = 0;
+      uint32_t maxSeg = 0;
+      bool found = false;
+
+      while (NULL != (entry = readdir(dir))) {
+         unsigned idx = 0;
+         // FAT 8.3 names may come back uppercase
+         if ((1 == sscanf(entry->d_name, "tl_%u.seg", &idx)) || (1 == sscanf(entry->d_name, "TL_%u.SEG", &idx))) {
+            if (!found || (idx < minSeg)) {
+               minSeg = idx;
+            }
+            if (!found || (idx > maxSeg)) {
+               maxSeg = idx;
+            }
+            found = true;
+         }
+      }
+      closedir(dir);
+
+      if (found) {
+         curSegment = maxSeg + 1;
+         // Trim segments that have fallen out of the retention window so
+         // the flash budget of (segments + 1) * segment size holds
+         for (uint32_t i = minSeg; (i + CONFIG_TIMELAPSE_MAX_SEGMENTS) <= curSegment; i++) {
+            char path[48];
+            Timelapse_GetSegmentPath(i, path, sizeof(path));
+            if (0 == unlink(path)) {
+               ESP_LOGI(TAG, "Deleted old segment %s", path);
+            }
+         }
+      }
+   }
+   ESP_LOGI(TAG, "Storage mounted, starting at segment %u", (unsigned)curSegment);
+
+   xTaskCreatePinnedToCore(task_recorder, "Timelapse", 4096, NULL, TASK_PRIO_ARCHIVE, NULL, TASK_CORE_COMMS);
+   return ESP_OK;
+}
+
+uint32_t Timelapse_GetCurrentSegment(void) {
+   return curSegment;
+}
+
+void Timelapse_GetSegmentPath(uint32_t Segment, char *Path, size_t PathLen) {
+   snprintf(Path, PathLen, TIMELAPSE_MOUNT "/tl_%04u.seg", (unsigned)Segment);
+}
+
+#endif   // CONFIG_TIMELAPSE_ENABLE
@@ -0,0 +1,63 @@
+/**
+ ******************************************************************************
+ *  file           : timelapse.h
+ *  brief          : Time-lapse recorder writing frame segments to flash
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef TIMELAPSE_H_
+#define TIMELAPSE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+#define TIMELAPSE_MOUNT "/spiflash"   // Mount point of the storage partition
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Mount the storage partition and start the recorder task
+ *
+ * Frames are appended as length-prefixed records into segment files;
+ * full segments rotate and the oldest segment is deleted when the
+ * segment budget is reached.
+ *
+ * @return esp_err_t
+ */
+esp_err_t Timelapse_Init(void);
+
+/**
+ * @brief Get the index of the segment currently being written
+ *
+ * @return uint32_t
+ */
+uint32_t Timelapse_GetCurrentSegment(void);
+
+/**
+ * @brief Build the path of a segment file
+ *
+ * @param Segment The segment index
+ * @param Path Output buffer
+ * @param PathLen Size of the buffer
+ */
+void Timelapse_GetSegmentPath(uint32_t Segment, char *Path, size_t PathLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // TIMELAPSE_H_
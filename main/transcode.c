@@ -0,0 +1,114 @@
+/**
+ ******************************************************************************
+ *  file           : transcode.c
+ *  brief          : JPEG rescale/re-quality stage for per-consumer image sizes
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "transcode.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+#include "bufpool.h"
+#include "esp_log.h"
+#include "img_converters.h"
+
+/* Private typedef -----------------------------------------------------------*/
+
+typedef struct {
+   const uint8_t *jpg;   // JPEG input for the decode reader
+   size_t jpg_len;
+   uint8_t *rgb;   // RGB888 output plane
+   uint16_t width;
+   uint16_t height;
+} decode_ctx_t;
+
+/* Private define ------------------------------------------------------------*/
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "TRANSCODE";
+
+/* Private function prototypes -----------------------------------------------*/
+
+static size_t jpg_read_cb(void *arg, size_t index, uint8_t *buf, size_t len);
+static bool jpg_write_cb(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Reader for esp_jpg_decode, feeds from the framebuffer
+ */
+static size_t jpg_read_cb(void *arg, size_t index, uint8_t *buf, size_t len) {
+   decode_ctx_t *ctx = (decode_ctx_t *)arg;
+   if (index + len > ctx->jpg_len) {
+      len = ctx->jpg_len - index;
+   }
+   if (NULL != buf) {
+      memcpy(buf, ctx->jpg + index, len);
+   }
+   return len;
+}
+
+/**
+ * @brief Writer for esp_jpg_decode, copies RGB888 blocks into the plane
+ */
+static bool jpg_write_cb(void *arg, uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint8_t *data) {
+   decode_ctx_t *ctx = (decode_ctx_t *)arg;
+   if (NULL == data) {
+      return true;   // Start/end marker
+   }
+   for (uint16_t row = 0; row < h; row++) {
+      if ((y + row) >= ctx->height) {
+         break;
+      }
+      uint16_t cols = w;
+      if ((x + cols) > ctx->width) {
+         cols = ctx->width - x;
+      }
+      memcpy(ctx->rgb + ((y + row) * ctx->width + x) * 3, data + row * w * 3, cols * 3);
+   }
+   return true;
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t Transcode_JpegScale(const camera_fb_t *fb, jpg_scale_t Scale, uint8_t Quality, uint8_t **OutJpg,
+                              size_t *OutLen) {
+   if ((NULL == fb) || (fb->format != PIXFORMAT_JPEG) || (NULL == OutJpg) || (NULL == OutLen)) {
+      return ESP_ERR_INVALID_ARG;
+   }
+
+   const uint16_t width = fb->width >> Scale;
+   const uint16_t height = fb->height >> Scale;
+
+   decode_ctx_t ctx = {
+       .jpg = fb->buf,
+       .jpg_len = fb->len,
+       .rgb = BufPool_Acquire(width * height * 3),   // Pooled, no per-frame heap churn
+       .width = width,
+       .height = height,
+   };
+   if (NULL == ctx.rgb) {
+      ESP_LOGE(TAG, "Failed to allocate %u bytes for RGB plane", width * height * 3);
+      return ESP_ERR_NO_MEM;
+   }
+
+   esp_err_t res = esp_jpg_decode(fb->len, Scale, jpg_read_cb, jpg_write_cb, &ctx);
+   if (ESP_OK == res) {
+      if (!fmt2jpg(ctx.rgb, width * height * 3, width, height, PIXFORMAT_RGB888, Quality, OutJpg, OutLen)) {
+         ESP_LOGE(TAG, "JPEG encode failed");
+         res = ESP_FAIL;
+      }
+   } else {
+      ESP_LOGE(TAG, "JPEG decode failed");
+   }
+
+   BufPool_Release(ctx.rgb);
+   return res;
+}
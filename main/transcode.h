@@ -0,0 +1,54 @@
+/**
+ ******************************************************************************
+ *  file           : transcode.h
+ *  brief          : JPEG rescale/re-quality stage for per-consumer image sizes
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef TRANSCODE_H_
+#define TRANSCODE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include <esp_camera.h>
+
+#include "esp_jpg_decode.h"
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Re-encode a JPEG frame at a smaller scale and different quality
+ *
+ * Decodes the frame at 1/2, 1/4 or 1/8 scale into a PSRAM RGB buffer and
+ * re-encodes it, so consumers like the MQTT snapshot get a right-sized
+ * image without reconfiguring the sensor.
+ *
+ * @param fb The captured frame (JPEG)
+ * @param Scale Decode scale (JPG_SCALE_2X/4X/8X)
+ * @param Quality JPEG quality of the output (0-100)
+ * @param OutJpg Receives the encoded image, caller frees with free()
+ * @param OutLen Receives the encoded length
+ * @return esp_err_t
+ */
+esp_err_t Transcode_JpegScale(const camera_fb_t *fb, jpg_scale_t Scale, uint8_t Quality, uint8_t **OutJpg,
+                              size_t *OutLen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // TRANSCODE_H_
@@ -0,0 +1,137 @@
+/**
+ ******************************************************************************
+ *  file           : udpcast.c
+ *  brief          : UDP multicast frame streaming
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "udpcast.h"
+
+#include <string.h>
+
+/* Private includes ----------------------------------------------------------*/
+
+#include "broadcast.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/sockets.h"
+#include "perfmon.h"
+#include "sdkconfig.h"
+#include "taskcfg.h"
+
+#ifdef CONFIG_UDPCAST_ENABLE
+
+/* Private typedef -----------------------------------------------------------*/
+
+// Datagram header, followed by the JPEG fragment
+typedef struct {
+   uint32_t frameSeq;    // Frame number, shared by all fragments of a frame
+   uint16_t fragIndex;   // Fragment index within the frame
+   uint16_t fragCount;   // Total fragments of the frame
+   uint32_t frameLen;    // Total JPEG size in bytes
+   int64_t timestamp;    // Capture time in us since boot
+} __attribute__((packed)) frag_hdr_t;
+
+/* Private define ------------------------------------------------------------*/
+
+#define FRAG_PAYLOAD 1400   // JPEG bytes per datagram, fits one ethernet frame
+#define FRAG_BURST   8      // Fragments sent back-to-back before yielding
+
+/* Private macro -------------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static const char *TAG = "UDPCAST";
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void task_udpcast(void *pvParameters);
+
+/* Private user code ---------------------------------------------------------*/
+
+/**
+ * @brief Task: Fragment every frame into datagrams towards the group
+ *
+ * Yields briefly between bursts so large frames do not exhaust the
+ * lwIP packet buffers or starve the TCP endpoints.
+ *
+ * @param pvParameters unused
+ */
+static void task_udpcast(void *pvParameters) {
+   static uint8_t datagram[sizeof(frag_hdr_t) + FRAG_PAYLOAD];
+   uint32_t frameSeq = 0;
+
+   const int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+   if (sock < 0) {
+      ESP_LOGE(TAG, "Cannot create socket!");
+      vTaskDelete(NULL);
+   }
+   const uint8_t ttl = 1;   // LAN only
+   setsockopt(sock, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+
+   struct sockaddr_in dest = {
+       .sin_family = AF_INET,
+       .sin_port = htons(CONFIG_UDPCAST_PORT),
+       .sin_addr.s_addr = inet_addr(CONFIG_UDPCAST_GROUP),
+   };
+
+   BC_Client *client = BC_Register(0);
+   if (NULL == client) {
+      ESP_LOGE(TAG, "Cannot register at the broadcaster!");
+      close(sock);
+      vTaskDelete(NULL);
+   }
+   ESP_LOGI(TAG, "Streaming to %s:%d", CONFIG_UDPCAST_GROUP, CONFIG_UDPCAST_PORT);
+
+   while (1) {
+      BC_Frame *frame = BC_WaitFrame(client, pdMS_TO_TICKS(1000));
+      if (NULL == frame) {
+         continue;
+      }
+
+      frag_hdr_t hdr = {
+          .frameSeq = frameSeq++,
+          .fragCount = (frame->fb->len + FRAG_PAYLOAD - 1) / FRAG_PAYLOAD,
+          .frameLen = frame->fb->len,
+          .timestamp = esp_timer_get_time(),
+      };
+
+      const int64_t sendStart = PERF_TimerStart();
+      for (hdr.fragIndex = 0; hdr.fragIndex < hdr.fragCount; hdr.fragIndex++) {
+         const size_t offset = (size_t)hdr.fragIndex * FRAG_PAYLOAD;
+         const size_t len = (frame->fb->len - offset > FRAG_PAYLOAD) ? FRAG_PAYLOAD : (frame->fb->len - offset);
+
+         memcpy(datagram, &hdr, sizeof(hdr));
+         memcpy(datagram + sizeof(hdr), frame->fb->buf + offset, len);
+         if (sendto(sock, datagram, sizeof(hdr) + len, 0, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+            // Transient buffer exhaustion, receivers skip the torn frame
+            break;
+         }
+         if (0 == ((hdr.fragIndex + 1) % FRAG_BURST)) {
+            vTaskDelay(1);
+         }
+      }
+      PERF_TimerStop(PERF_TIMER_STREAM_SEND, sendStart);
+      PERF_Add(PERF_CNT_STREAM_FRAMES, 1);
+      PERF_Add(PERF_CNT_STREAM_BYTES, frame->fb->len);
+      BC_ReleaseFrame(frame);
+   }
+}
+
+/* Public user code ----------------------------------------------------------*/
+
+esp_err_t UDPCast_Init(void) {
+   if (pdPASS !=
+       xTaskCreatePinnedToCore(task_udpcast, "UDP Cast", 4096, NULL, TASK_PRIO_STREAM, NULL, TASK_CORE_COMMS)) {
+      ESP_LOGE(TAG, "Failed to create task!");
+      return ESP_FAIL;
+   }
+   return ESP_OK;
+}
+
+#endif   // CONFIG_UDPCAST_ENABLE
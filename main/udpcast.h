@@ -0,0 +1,44 @@
+/**
+ ******************************************************************************
+ *  file           : udpcast.h
+ *  brief          : UDP multicast frame streaming
+ ******************************************************************************
+ *  Copyright (C) 2024 Florian Brandner
+ */
+
+#ifndef UDPCAST_H_
+#define UDPCAST_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Includes ------------------------------------------------------------------*/
+
+#include "esp_system.h"
+
+/* Private includes ----------------------------------------------------------*/
+
+/* Exported constants --------------------------------------------------------*/
+
+/* Exported types ------------------------------------------------------------*/
+
+/* Exported macro ------------------------------------------------------------*/
+
+/* Exported functions prototypes ---------------------------------------------*/
+
+/**
+ * @brief Start streaming frames to the configured multicast group
+ *
+ * Every frame is fragmented into sequence-numbered datagrams; any
+ * number of LAN viewers can join the group at constant device cost.
+ *
+ * @return esp_err_t
+ */
+esp_err_t UDPCast_Init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif   // UDPCAST_H_
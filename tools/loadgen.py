@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+"""Load generator for the ESP32Cam HTTP endpoints.
+
+Drives /snapshot pollers and /stream viewers against a device for a fixed
+duration and prints throughput/latency stats, optionally triggering the
+on-device /bench first. Stdlib only.
+
+Examples:
+    ./loadgen.py 192.168.1.50
+    ./loadgen.py 192.168.1.50 --duration 60 --snapshot-workers 4 --streams 2
+    ./loadgen.py 192.168.1.50 --bench 64
+"""
+
+import argparse
+import json
+import socket
+import statistics
+import threading
+import time
+import urllib.request
+
+
+def run_bench(host, iterations):
+    url = "http://%s/bench?n=%d" % (host, iterations)
+    print("Running on-device benchmark (%d iterations)..." % iterations)
+    with urllib.request.urlopen(url, timeout=120) as rsp:
+        print(json.dumps(json.loads(rsp.read()), indent=2))
+
+
+def snapshot_worker(host, deadline, results):
+    latencies = []
+    bytes_total = 0
+    errors = 0
+    while time.monotonic() < deadline:
+        start = time.monotonic()
+        try:
+            with urllib.request.urlopen("http://%s/snapshot" % host, timeout=10) as rsp:
+                bytes_total += len(rsp.read())
+            latencies.append(time.monotonic() - start)
+        except OSError:
+            errors += 1
+    results.append(("snapshot", latencies, bytes_total, errors))
+
+
+def stream_worker(host, deadline, results):
+    frames = []
+    bytes_total = 0
+    errors = 0
+    try:
+        sock = socket.create_connection((host, 80), timeout=10)
+        sock.sendall(b"GET /stream HTTP/1.1\r\nHost: %s\r\n\r\n" % host.encode())
+        last = time.monotonic()
+        while time.monotonic() < deadline:
+            data = sock.recv(65536)
+            if not data:
+                break
+            bytes_total += len(data)
+            # Frame boundaries mark a delivered frame
+            if b"--123456789000000000000987654321" in data:
+                now = time.monotonic()
+                frames.append(now - last)
+                last = now
+        sock.close()
+    except OSError:
+        errors += 1
+    results.append(("stream", frames, bytes_total, errors))
+
+
+def report(name, samples, bytes_total, errors, duration):
+    print("%-10s %6d ok  %3d err  %8.1f KB/s" % (name, len(samples), errors, bytes_total / duration / 1024), end="")
+    if samples:
+        print(
+            "  lat/gap avg %6.1f ms  p95 %6.1f ms  max %6.1f ms"
+            % (
+                statistics.mean(samples) * 1000,
+                sorted(samples)[int(len(samples) * 0.95)] * 1000,
+                max(samples) * 1000,
+            )
+        )
+    else:
+        print()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="device address")
+    parser.add_argument("--duration", type=int, default=30, help="load duration in seconds")
+    parser.add_argument("--snapshot-workers", type=int, default=2, help="parallel /snapshot pollers")
+    parser.add_argument("--streams", type=int, default=1, help="parallel /stream viewers")
+    parser.add_argument("--bench", type=int, metavar="N", help="run /bench?n=N before the load phase")
+    args = parser.parse_args()
+
+    if args.bench:
+        run_bench(args.host, args.bench)
+
+    deadline = time.monotonic() + args.duration
+    results = []
+    threads = [
+        threading.Thread(target=snapshot_worker, args=(args.host, deadline, results))
+        for _ in range(args.snapshot_workers)
+    ] + [threading.Thread(target=stream_worker, args=(args.host, deadline, results)) for _ in range(args.streams)]
+
+    print("Loading %s for %d s (%d snapshot pollers, %d streams)..."
+          % (args.host, args.duration, args.snapshot_workers, args.streams))
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+
+    for name, samples, bytes_total, errors in results:
+        report(name, samples, bytes_total, errors, args.duration)
+
+
+if __name__ == "__main__":
+    main()